@@ -0,0 +1,438 @@
+// Runs the same workloads through pevents and through the primitives a Linux program would
+// otherwise build on, so that the cost of the Win32 event semantics is visible next to them:
+//  * ping_pong: a round trip between two threads handing a pair of auto-reset events back and
+//    forth
+//  * broadcast: a manual-reset event waking a number of waiters, including the wait for all of
+//    them to acknowledge it before the next broadcast
+//  * multi_wait: a round trip to a thread waiting on any of a number of auto-reset events, the
+//    set event rotating between them
+//
+// Each alternative implements the same semantics in the way that is natural to it: a flag under a
+// std::mutex and std::condition_variable, an eventfd polled for readability, and a word waited on
+// with a raw futex or with C++20 std::atomic::wait. The latter two wait on several events through
+// one word with a bit per event, as that is how a futex-based program would do it.
+//
+// Usage: Alternatives [repetitions]
+#include "bench.h"
+#include <atomic>
+#include <condition_variable>
+#include <linux/futex.h>
+#include <memory>
+#include <mutex>
+#include <pevents.h>
+#include <poll.h>
+#include <string>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+    struct Pevents {
+        class Event {
+        public:
+            explicit Event(bool manualReset) : Handle(neosmart::CreateEvent(manualReset)) {
+            }
+            ~Event() {
+                neosmart::DestroyEvent(Handle);
+            }
+            void Set() {
+                neosmart::SetEvent(Handle);
+            }
+            void Reset() {
+                neosmart::ResetEvent(Handle);
+            }
+            void Wait() {
+                neosmart::WaitForEvent(Handle);
+            }
+
+        private:
+            neosmart::neosmart_event_t Handle;
+        };
+
+#ifdef WFMO
+        class Group {
+        public:
+            explicit Group(int count) : Handles(count) {
+                for (neosmart::neosmart_event_t &handle : Handles) {
+                    handle = neosmart::CreateEvent();
+                }
+            }
+            ~Group() {
+                for (neosmart::neosmart_event_t handle : Handles) {
+                    neosmart::DestroyEvent(handle);
+                }
+            }
+            void Set(int i) {
+                neosmart::SetEvent(Handles[i]);
+            }
+            int WaitAny() {
+                int index;
+                neosmart::WaitForMultipleEvents(Handles.data(), (int)Handles.size(), false, -1ul,
+                                                index);
+                return index;
+            }
+
+        private:
+            std::vector<neosmart::neosmart_event_t> Handles;
+        };
+#endif
+    };
+
+    struct ConditionVariable {
+        class Event {
+        public:
+            explicit Event(bool manualReset) : ManualReset(manualReset) {
+            }
+            void Set() {
+                std::lock_guard<std::mutex> lock(Mutex);
+                State = true;
+                if (ManualReset) {
+                    Condition.notify_all();
+                } else {
+                    Condition.notify_one();
+                }
+            }
+            void Reset() {
+                std::lock_guard<std::mutex> lock(Mutex);
+                State = false;
+            }
+            void Wait() {
+                std::unique_lock<std::mutex> lock(Mutex);
+                Condition.wait(lock, [this]() { return State; });
+                State = ManualReset;
+            }
+
+        private:
+            std::mutex Mutex;
+            std::condition_variable Condition;
+            bool ManualReset;
+            bool State = false;
+        };
+
+        // The events share a mutex and condition variable, with a flag for each
+        class Group {
+        public:
+            explicit Group(int count) : States(count, false) {
+            }
+            void Set(int i) {
+                std::lock_guard<std::mutex> lock(Mutex);
+                States[i] = true;
+                Condition.notify_one();
+            }
+            int WaitAny() {
+                std::unique_lock<std::mutex> lock(Mutex);
+                while (true) {
+                    for (size_t i = 0; i < States.size(); ++i) {
+                        if (States[i]) {
+                            States[i] = false;
+                            return (int)i;
+                        }
+                    }
+                    Condition.wait(lock);
+                }
+            }
+
+        private:
+            std::mutex Mutex;
+            std::condition_variable Condition;
+            std::vector<bool> States;
+        };
+    };
+
+    struct EventFd {
+        // Set while the eventfd's counter is non-zero. Waiters poll for it to become readable, and
+        // those of an auto-reset event then race to read, and so zero, the counter.
+        class Event {
+        public:
+            explicit Event(bool manualReset)
+                : Fd(eventfd(0, EFD_NONBLOCK)), ManualReset(manualReset) {
+            }
+            ~Event() {
+                close(Fd);
+            }
+            void Set() {
+                Signal(Fd);
+            }
+            void Reset() {
+                uint64_t value;
+                (void)!read(Fd, &value, sizeof(value));
+            }
+            void Wait() {
+                struct pollfd pfd = {Fd, POLLIN, 0};
+                uint64_t value;
+                do {
+                    poll(&pfd, 1, -1);
+                } while (!ManualReset && read(Fd, &value, sizeof(value)) != sizeof(value));
+            }
+
+            static void Signal(int fd) {
+                uint64_t one = 1;
+                (void)!write(fd, &one, sizeof(one));
+            }
+
+        private:
+            int Fd;
+            bool ManualReset;
+        };
+
+        class Group {
+        public:
+            explicit Group(int count) : Fds(count) {
+                for (struct pollfd &pfd : Fds) {
+                    pfd = {eventfd(0, EFD_NONBLOCK), POLLIN, 0};
+                }
+            }
+            ~Group() {
+                for (struct pollfd &pfd : Fds) {
+                    close(pfd.fd);
+                }
+            }
+            void Set(int i) {
+                Event::Signal(Fds[i].fd);
+            }
+            int WaitAny() {
+                uint64_t value;
+                while (true) {
+                    poll(Fds.data(), Fds.size(), -1);
+                    for (size_t i = 0; i < Fds.size(); ++i) {
+                        if ((Fds[i].revents & POLLIN) &&
+                            read(Fds[i].fd, &value, sizeof(value)) == sizeof(value)) {
+                            return (int)i;
+                        }
+                    }
+                }
+            }
+
+        private:
+            std::vector<struct pollfd> Fds;
+        };
+    };
+
+    // Waits on and wakes a word with a raw futex system call, or with std::atomic::wait
+    struct FutexWord {
+        static void Wait(std::atomic<uint32_t> &word, uint32_t value) {
+            syscall(SYS_futex, (uint32_t *)&word, FUTEX_WAIT_PRIVATE, value, nullptr, nullptr, 0);
+        }
+        static void Wake(std::atomic<uint32_t> &word, bool all) {
+            syscall(SYS_futex, (uint32_t *)&word, FUTEX_WAKE_PRIVATE, all ? INT32_MAX : 1,
+                    nullptr, nullptr, 0);
+        }
+    };
+
+#ifdef __cpp_lib_atomic_wait
+    struct AtomicWord {
+        static void Wait(std::atomic<uint32_t> &word, uint32_t value) {
+            word.wait(value);
+        }
+        static void Wake(std::atomic<uint32_t> &word, bool all) {
+            if (all) {
+                word.notify_all();
+            } else {
+                word.notify_one();
+            }
+        }
+    };
+#endif
+
+    // An event as a single word, which is non-zero while set. A set only wakes waiters when it
+    // changes the word, as any waiter still asleep must have seen it clear.
+    template <typename Word> struct WordBackend {
+        class Event {
+        public:
+            explicit Event(bool manualReset) : ManualReset(manualReset) {
+            }
+            void Set() {
+                if (State.exchange(1) == 0) {
+                    Word::Wake(State, ManualReset);
+                }
+            }
+            void Reset() {
+                State = 0;
+            }
+            void Wait() {
+                if (ManualReset) {
+                    while (State.load() == 0) {
+                        Word::Wait(State, 0);
+                    }
+                } else {
+                    while (State.exchange(0) == 0) {
+                        Word::Wait(State, 0);
+                    }
+                }
+            }
+
+        private:
+            std::atomic<uint32_t> State{0};
+            bool ManualReset;
+        };
+
+        // Up to 32 events as the bits of one word
+        class Group {
+        public:
+            explicit Group(int count) {
+                (void)count;
+            }
+            void Set(int i) {
+                if (States.fetch_or(1u << i) == 0) {
+                    Word::Wake(States, false);
+                }
+            }
+            int WaitAny() {
+                uint32_t states = States.load();
+                while (true) {
+                    if (states == 0) {
+                        Word::Wait(States, 0);
+                        states = States.load();
+                        continue;
+                    }
+                    int i = __builtin_ctz(states);
+                    if (States.compare_exchange_weak(states, states & ~(1u << i))) {
+                        return i;
+                    }
+                }
+            }
+
+        private:
+            std::atomic<uint32_t> States{0};
+        };
+    };
+
+    template <typename Backend> void PingPong(bench::Suite &suite, const std::string &backend) {
+        typename Backend::Event ping(false);
+        typename Backend::Event pong(false);
+        std::atomic<bool> stop(false);
+
+        std::thread ponger([&]() {
+            bench::Pin(1);
+            while (true) {
+                ping.Wait();
+                if (stop.load(std::memory_order_relaxed)) {
+                    break;
+                }
+                pong.Set();
+            }
+        });
+
+        bench::Pin(0);
+        suite.Run("ping_pong/" + backend, [&](uint64_t iterations) {
+            for (uint64_t i = 0; i < iterations; ++i) {
+                ping.Set();
+                pong.Wait();
+            }
+        });
+
+        stop = true;
+        ping.Set();
+        ponger.join();
+    }
+
+    // Broadcasts alternate between two manual-reset events, so that one can be reset for the next
+    // broadcast while waiters are still waking from the other. The last waiter to wake sets an
+    // auto-reset event that the broadcaster waits on.
+    template <typename Backend>
+    void Broadcast(bench::Suite &suite, const std::string &backend, int waiters) {
+        typename Backend::Event phases[2] = {typename Backend::Event(true),
+                                             typename Backend::Event(true)};
+        typename Backend::Event done(false);
+        std::atomic<int> woken(0);
+        std::atomic<bool> stop(false);
+
+        std::vector<std::thread> threads;
+        for (int j = 0; j < waiters; ++j) {
+            threads.emplace_back([&, j]() {
+                bench::Pin(1 + j);
+                for (int phase = 0;; phase ^= 1) {
+                    phases[phase].Wait();
+                    if (stop.load(std::memory_order_relaxed)) {
+                        break;
+                    }
+                    if (++woken == waiters) {
+                        woken = 0;
+                        done.Set();
+                    }
+                }
+            });
+        }
+
+        int phase = 0;
+        bench::Pin(0);
+        suite.Run("broadcast/" + backend, {{"waiters", waiters}}, [&](uint64_t iterations) {
+            for (uint64_t i = 0; i < iterations; ++i, phase ^= 1) {
+                phases[phase ^ 1].Reset();
+                phases[phase].Set();
+                done.Wait();
+            }
+        });
+
+        stop = true;
+        phases[0].Set();
+        phases[1].Set();
+        for (std::thread &thread : threads) {
+            thread.join();
+        }
+    }
+
+    template <typename Backend>
+    void MultiWait(bench::Suite &suite, const std::string &backend, int count) {
+        typename Backend::Group group(count);
+        typename Backend::Event ack(false);
+        std::atomic<bool> stop(false);
+
+        std::thread waiter([&]() {
+            bench::Pin(1);
+            while (true) {
+                group.WaitAny();
+                if (stop.load(std::memory_order_relaxed)) {
+                    break;
+                }
+                ack.Set();
+            }
+        });
+
+        int next = 0;
+        bench::Pin(0);
+        suite.Run("multi_wait/" + backend, {{"count", count}}, [&](uint64_t iterations) {
+            for (uint64_t i = 0; i < iterations; ++i) {
+                group.Set(next);
+                next = (next + 1) % count;
+                ack.Wait();
+            }
+        });
+
+        stop = true;
+        group.Set(0);
+        waiter.join();
+    }
+
+    template <typename Backend> void Compare(bench::Suite &suite, const std::string &backend) {
+        PingPong<Backend>(suite, backend);
+        for (int waiters : {1, 4, 16}) {
+            Broadcast<Backend>(suite, backend, waiters);
+        }
+        for (int count : {2, 8, 32}) {
+            MultiWait<Backend>(suite, backend, count);
+        }
+    }
+} // namespace
+
+int main(int argc, const char *argv[]) {
+    bench::Suite suite("Alternatives", argc, argv);
+
+#ifdef WFMO
+    Compare<Pevents>(suite, "pevents");
+#else
+    PingPong<Pevents>(suite, "pevents");
+    for (int waiters : {1, 4, 16}) {
+        Broadcast<Pevents>(suite, "pevents", waiters);
+    }
+#endif
+    Compare<ConditionVariable>(suite, "condition_variable");
+    Compare<EventFd>(suite, "eventfd");
+    Compare<WordBackend<FutexWord>>(suite, "futex");
+#ifdef __cpp_lib_atomic_wait
+    Compare<WordBackend<AtomicWord>>(suite, "atomic_wait");
+#endif
+    return 0;
+}
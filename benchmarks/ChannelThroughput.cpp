@@ -0,0 +1,81 @@
+// Measures the throughput of a shared-memory channel between two processes: the parent produces
+// fixed-size messages in batches and a forked child consumes them.
+//
+// Usage: ChannelThroughput [messages] [message size] [batch size]
+#include <chrono>
+#include <iostream>
+#include <pchannel.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace neosmart;
+
+int consumer(const std::string &name, uint64_t messages, uint32_t batch) {
+    neosmart_channel_t channel = OpenChannel(name.c_str());
+    if (channel == nullptr) {
+        return 2;
+    }
+    uint64_t sum = 0;
+    for (uint64_t i = 0; i < messages; ++i) {
+        uint32_t size;
+        const void *message = ChannelRead(channel, size);
+        uint64_t value;
+        memcpy(&value, message, sizeof(value));
+        sum += value;
+        if ((i + 1) % batch == 0) {
+            ChannelRelease(channel);
+        }
+    }
+    ChannelRelease(channel);
+    DestroyChannel(channel);
+    return sum == messages * (messages - 1) / 2 ? 0 : 1;
+}
+
+int main(int argc, const char *argv[]) {
+    uint64_t messages = argc > 1 ? strtoull(argv[1], nullptr, 10) : 10000000;
+    uint32_t size = argc > 2 ? atoi(argv[2]) : 32;
+    uint32_t batch = argc > 3 ? atoi(argv[3]) : 16;
+    if (size < sizeof(uint64_t)) {
+        size = sizeof(uint64_t);
+    }
+
+    std::string name = "bench.channel." + std::to_string(getpid());
+    neosmart_channel_t channel = CreateChannel(name.c_str(), 1 << 20);
+    if (channel == nullptr) {
+        std::cout << "Couldn't create the channel!" << std::endl;
+        return 1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    pid_t pid = fork();
+    if (pid == 0) {
+        _exit(consumer(name, messages, batch));
+    }
+
+    for (uint64_t i = 0; i < messages; ++i) {
+        void *message = ChannelReserve(channel, size);
+        memcpy(message, &i, sizeof(i));
+        if ((i + 1) % batch == 0) {
+            ChannelCommit(channel);
+        }
+    }
+    ChannelCommit(channel);
+
+    int status = -1;
+    waitpid(pid, &status, 0);
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    DestroyChannel(channel);
+
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        std::cout << "Consumer couldn't open the channel or received corrupted messages!"
+                  << std::endl;
+        return 1;
+    }
+
+    std::cout << messages << " messages of " << size << " bytes in batches of " << batch << ": "
+              << messages / elapsed << " messages/sec" << std::endl;
+    return 0;
+}
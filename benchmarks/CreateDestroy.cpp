@@ -0,0 +1,44 @@
+// Measures how quickly events can be created and destroyed, one at a time and in bulk.
+//
+// Usage: CreateDestroy [repetitions]
+#include "bench.h"
+#include <pevents.h>
+#include <vector>
+
+using namespace neosmart;
+
+int main(int argc, const char *argv[]) {
+    bench::Suite suite("CreateDestroy", argc, argv);
+
+    suite.Run("create_destroy", [](uint64_t iterations) {
+        for (uint64_t i = 0; i < iterations; ++i) {
+            DestroyEvent(CreateEvent());
+        }
+    });
+
+    // Per event, with a whole batch alive at once so the allocator can't keep handing back the
+    // same block
+    const int batch = 1024;
+    std::vector<neosmart_event_t> events(batch);
+    suite.Run("create_then_destroy", {{"batch", batch}}, [&](uint64_t iterations) {
+        for (uint64_t i = 0; i < iterations; ++i) {
+            for (neosmart_event_t &event : events) {
+                event = CreateEvent();
+            }
+            for (neosmart_event_t event : events) {
+                DestroyEvent(event);
+            }
+        }
+    }, batch);
+
+    // Per event, with each batch made by a single CreateEvents() call
+    for (int bulk : {16, batch}) {
+        suite.Run("create_events_bulk", {{"batch", bulk}}, [&](uint64_t iterations) {
+            for (uint64_t i = 0; i < iterations; ++i) {
+                CreateEvents(events.data(), bulk, 0);
+                DestroyEvents(events.data(), bulk);
+            }
+        }, bulk);
+    }
+    return 0;
+}
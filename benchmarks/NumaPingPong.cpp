@@ -0,0 +1,88 @@
+// Measures auto-reset ping-pong round trips between threads pinned to each pair of NUMA nodes,
+// with the events placed on the first thread's node, the second thread's node, or wherever the
+// default allocator puts them. On a single-node machine only the 0 <-> 0 case is run.
+//
+// Usage: NumaPingPong [round trips]
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <pevents.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace neosmart;
+
+// The first CPU of each NUMA node
+std::vector<int> NodeCpus() {
+    std::vector<int> cpus;
+    for (int node = 0;; ++node) {
+        std::ifstream list("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+        int cpu;
+        if (!(list >> cpu)) {
+            break;
+        }
+        cpus.push_back(cpu);
+    }
+    if (cpus.empty()) {
+        cpus.push_back(0);
+    }
+    return cpus;
+}
+
+void Pin(int cpu) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+double PingPong(int pingCpu, int pongCpu, const neosmart_allocator_t *allocator, int rounds) {
+    neosmart_event_t ping = CreateEvent(false, false, allocator);
+    neosmart_event_t pong = CreateEvent(false, false, allocator);
+
+    std::thread ponger([&]() {
+        Pin(pongCpu);
+        for (int i = 0; i < rounds; ++i) {
+            WaitForEvent(ping);
+            SetEvent(pong);
+        }
+    });
+
+    Pin(pingCpu);
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; ++i) {
+        SetEvent(ping);
+        WaitForEvent(pong);
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    ponger.join();
+
+    DestroyEvent(ping);
+    DestroyEvent(pong);
+    return std::chrono::duration<double, std::nano>(elapsed).count() / rounds;
+}
+
+int main(int argc, const char *argv[]) {
+    int rounds = argc > 1 ? atoi(argv[1]) : 100000;
+    std::vector<int> cpus = NodeCpus();
+
+    std::cout << "ping node\tpong node\tevents on\tround trip (ns)" << std::endl;
+    for (size_t a = 0; a < cpus.size(); ++a) {
+        for (size_t b = 0; b < cpus.size(); ++b) {
+            std::cout << a << "\t" << b << "\tdefault\t"
+                      << PingPong(cpus[a], cpus[b], GetDefaultAllocator(), rounds) << std::endl;
+            std::cout << a << "\t" << b << "\tnode " << a << "\t"
+                      << PingPong(cpus[a], cpus[b], GetNumaAllocator(a), rounds) << std::endl;
+            if (a != b) {
+                std::cout << a << "\t" << b << "\tnode " << b << "\t"
+                          << PingPong(cpus[a], cpus[b], GetNumaAllocator(b), rounds) << std::endl;
+            }
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,42 @@
+// Measures the round trip between two threads handing a pair of auto-reset events back and forth,
+// which is dominated by the cost of waking a blocked waiter.
+//
+// Usage: PingPong [repetitions]
+#include "bench.h"
+#include <atomic>
+#include <pevents.h>
+#include <thread>
+
+using namespace neosmart;
+
+int main(int argc, const char *argv[]) {
+    bench::Suite suite("PingPong", argc, argv);
+    neosmart_event_t ping = CreateEvent();
+    neosmart_event_t pong = CreateEvent();
+    std::atomic<bool> stop(false);
+
+    // Keeps answering until stopped, as the harness decides how many round trips each run takes
+    std::thread ponger([&]() {
+        while (true) {
+            WaitForEvent(ping);
+            if (stop.load(std::memory_order_relaxed)) {
+                break;
+            }
+            SetEvent(pong);
+        }
+    });
+
+    suite.Run("round_trip_auto", [&](uint64_t iterations) {
+        for (uint64_t i = 0; i < iterations; ++i) {
+            SetEvent(ping);
+            WaitForEvent(pong);
+        }
+    });
+
+    stop = true;
+    SetEvent(ping);
+    ponger.join();
+    DestroyEvent(ping);
+    DestroyEvent(pong);
+    return 0;
+}
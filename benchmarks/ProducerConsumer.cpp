@@ -0,0 +1,120 @@
+// The workload of examples/sample.cpp without its sleeps: letter and number producers take turns
+// through an auto-reset "protection" event per kind, publish an item and set that kind's
+// auto-reset "available" event, and a consumer in WaitForMultipleEvents() takes each item and
+// hands the protection event back. Reports items per second and the latency from an item being
+// published to the consumer waking for it, with the consumer and producers pinned to their own
+// CPUs where there are enough.
+//
+// Usage: ProducerConsumer [repetitions] [letter producers] [number producers] [items]
+// Without producer counts, a range of them is swept. Each repetition consumes `items` items
+// (100000 by default).
+#include "bench.h"
+#include <atomic>
+#include <pevents.h>
+#include <thread>
+#include <vector>
+
+using namespace neosmart;
+
+static uint64_t Now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+// An item kind: its protection and available events, and when its last item was published
+struct Kind {
+    neosmart_event_t Available;
+    neosmart_event_t Protection;
+    uint64_t PublishTime;
+};
+
+static void Produce(Kind &kind, neosmart_event_t abort) {
+    neosmart_event_t waits[2] = {kind.Protection, abort};
+    int index;
+    // Producers waiting their turn must also see the abort, as the consumer stops handing the
+    // protection event back
+    while (WaitForMultipleEvents(waits, 2, false, -1ul, index) == 0 && index == 0) {
+        kind.PublishTime = Now();
+        SetEvent(kind.Available);
+    }
+}
+
+static void Run(bench::Suite &suite, int letterProducers, int numberProducers, uint64_t items) {
+    std::vector<double> rates;
+    std::vector<double> latencies;
+    latencies.reserve(items * suite.Repetitions());
+
+    for (int repetition = 0; repetition < suite.Repetitions(); ++repetition) {
+        Kind kinds[2];
+        neosmart_event_t available[2];
+        for (Kind &kind : kinds) {
+            kind.Available = CreateEvent();
+            kind.Protection = CreateEvent(false, true);
+        }
+        available[0] = kinds[0].Available;
+        available[1] = kinds[1].Available;
+        neosmart_event_t abort = CreateEvent(true, false);
+
+        std::vector<std::thread> threads;
+        for (int i = 0; i < letterProducers + numberProducers; ++i) {
+            Kind &kind = kinds[i < letterProducers ? 0 : 1];
+            threads.emplace_back([&, i]() {
+                bench::Pin(1 + i);
+                Produce(kind, abort);
+            });
+        }
+
+        bench::Pin(0);
+        uint64_t start = Now();
+        for (uint64_t i = 0; i < items; ++i) {
+            int index;
+            WaitForMultipleEvents(available, 2, false, -1ul, index);
+            latencies.push_back(Now() - kinds[index].PublishTime);
+            SetEvent(kinds[index].Protection);
+        }
+        rates.push_back(items / ((Now() - start) / 1e9));
+
+        SetEvent(abort);
+        for (std::thread &thread : threads) {
+            thread.join();
+        }
+        for (Kind &kind : kinds) {
+            DestroyEvent(kind.Available);
+            DestroyEvent(kind.Protection);
+        }
+        DestroyEvent(abort);
+    }
+
+    suite.Record("producer_consumer",
+                 {{"letter_producers", letterProducers},
+                  {"number_producers", numberProducers},
+                  {"items", (int64_t)items}},
+                 {{"items_per_sec", bench::Percentile(rates, 0.5)},
+                  {"p50_ns", bench::Percentile(latencies, 0.5)},
+                  {"p99_ns", bench::Percentile(latencies, 0.99)},
+                  {"p999_ns", bench::Percentile(latencies, 0.999)}});
+}
+
+int main(int argc, const char *argv[]) {
+    bench::Suite suite("ProducerConsumer", argc, argv);
+    uint64_t items = argc > 4 ? std::max(atoll(argv[4]), 1ll) : 100000;
+
+    if (argc > 3) {
+        int letterProducers = std::max(atoi(argv[2]), 0);
+        int numberProducers = std::max(atoi(argv[3]), 0);
+        // Something must produce the items
+        if (letterProducers + numberProducers == 0) {
+            letterProducers = 1;
+        }
+        Run(suite, letterProducers, numberProducers, items);
+        return 0;
+    }
+
+    // Only one kind produced, then both, with ever more producers competing for each turn
+    Run(suite, 1, 0, items);
+    for (int producers : {1, 2, 4, 10}) {
+        Run(suite, producers, producers, items);
+    }
+    return 0;
+}
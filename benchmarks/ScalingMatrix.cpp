@@ -0,0 +1,225 @@
+// Sweeps the number of setting and waiting threads and of events, reporting wake throughput and
+// set-to-wake latency percentiles for each combination. Threads are pinned round-robin across the
+// CPUs, setters first. Three workloads are covered:
+//  * handoff_auto: setters hand auto-reset events to waiters one set at a time, with each waiter
+//    blocked on a single event
+//  * broadcast_manual: a setter per manual-reset event wakes all of that event's waiters at once,
+//    then waits for every one of them before the next broadcast
+//  * handoff_wfmo: as handoff_auto, but every waiter waits on all the events at once, so that each
+//    set walks the waits the other waiters registered
+//
+// Usage: ScalingMatrix [repetitions], where each case runs for 20ms per repetition
+#include "bench.h"
+#include <atomic>
+#include <pevents.h>
+#include <thread>
+#include <vector>
+
+using namespace neosmart;
+
+static uint64_t Now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+// An event being handed off, on a cache line of its own
+struct alignas(64) Handoff {
+    // When the event was set, and whether that set has yet to be taken by a waiter
+    std::atomic<uint64_t> SetTime{0};
+    std::atomic<bool> Pending{false};
+};
+
+// Lets the threads of a case run for 20ms per repetition, then stops them, returning how long they
+// actually ran for, in seconds
+static double Measure(bench::Suite &suite, std::atomic<bool> &stop) {
+    uint64_t start = Now();
+    std::this_thread::sleep_for(std::chrono::milliseconds(20 * suite.Repetitions()));
+    stop = true;
+    return (Now() - start) / 1e9;
+}
+
+static bench::Metrics Summarize(std::vector<std::vector<double>> &perThread, double seconds) {
+    std::vector<double> latencies;
+    for (const std::vector<double> &thread : perThread) {
+        latencies.insert(latencies.end(), thread.begin(), thread.end());
+    }
+    return {{"wakes_per_sec", latencies.size() / seconds},
+            {"p50_ns", bench::Percentile(latencies, 0.5)},
+            {"p99_ns", bench::Percentile(latencies, 0.99)},
+            {"p999_ns", bench::Percentile(latencies, 0.999)}};
+}
+
+static void RunHandoff(bench::Suite &suite, const char *name, int setters, int waiters,
+                       int count, bool multiWait) {
+    std::vector<neosmart_event_t> events(count);
+    std::vector<Handoff> handoffs(count);
+    for (neosmart_event_t &event : events) {
+        event = CreateEvent();
+    }
+    std::vector<std::vector<double>> latencies(waiters);
+    std::atomic<bool> stop(false);
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < setters; ++i) {
+        threads.emplace_back([&, i]() {
+            bench::Pin(i);
+            // Only sets events that have been taken, so that no set is lost to one before it
+            for (int e = i % count; !stop.load(std::memory_order_relaxed); e = (e + 1) % count) {
+                bool taken = false;
+                if (handoffs[e].Pending.compare_exchange_strong(taken, true)) {
+                    handoffs[e].SetTime.store(Now(), std::memory_order_relaxed);
+                    SetEvent(events[e]);
+                } else {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+    for (int j = 0; j < waiters; ++j) {
+        threads.emplace_back([&, j]() {
+            bench::Pin(setters + j);
+            while (!stop.load(std::memory_order_relaxed)) {
+                int e = j % count;
+                int result;
+#ifdef WFMO
+                if (multiWait) {
+                    result = WaitForMultipleEvents(events.data(), count, false, 10, e);
+                } else
+#else
+                (void)multiWait;
+#endif
+                {
+                    result = WaitForEvent(events[e], 10);
+                }
+                if (result == 0) {
+                    latencies[j].push_back(Now() -
+                                           handoffs[e].SetTime.load(std::memory_order_relaxed));
+                    handoffs[e].Pending.store(false);
+                }
+            }
+        });
+    }
+
+    double seconds = Measure(suite, stop);
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+    for (neosmart_event_t event : events) {
+        DestroyEvent(event);
+    }
+
+    suite.Record(name, {{"setters", setters}, {"waiters", waiters}, {"events", count}},
+                 Summarize(latencies, seconds));
+}
+
+// The events of one broadcast_manual setter. Broadcasts alternate between two manual-reset
+// events, so that one can be reset for the next broadcast while waiters are still waking from
+// the other.
+struct Broadcast {
+    neosmart_event_t Phases[2];
+    // Set by the last waiter to wake from a broadcast
+    neosmart_event_t Done;
+    std::atomic<int> Woken{0};
+    std::atomic<uint64_t> SetTime{0};
+};
+
+static void RunBroadcast(bench::Suite &suite, int count, int waitersPerEvent) {
+    std::vector<Broadcast> broadcasts(count);
+    for (Broadcast &broadcast : broadcasts) {
+        broadcast.Phases[0] = CreateEvent(true, false);
+        broadcast.Phases[1] = CreateEvent(true, false);
+        broadcast.Done = CreateEvent();
+    }
+    std::vector<std::vector<double>> latencies(count * waitersPerEvent);
+    std::atomic<uint64_t> sent(0);
+    std::atomic<bool> stop(false);
+
+    std::vector<std::thread> threads;
+    for (int e = 0; e < count; ++e) {
+        threads.emplace_back([&, e]() {
+            bench::Pin(e);
+            Broadcast &broadcast = broadcasts[e];
+            for (int phase = 0; !stop.load(std::memory_order_relaxed); phase ^= 1) {
+                ResetEvent(broadcast.Phases[phase ^ 1]);
+                broadcast.SetTime.store(Now(), std::memory_order_relaxed);
+                SetEvent(broadcast.Phases[phase]);
+                while (WaitForEvent(broadcast.Done, 10) != 0) {
+                    if (stop.load(std::memory_order_relaxed)) {
+                        return;
+                    }
+                }
+                ++sent;
+            }
+        });
+    }
+    for (int j = 0; j < count * waitersPerEvent; ++j) {
+        threads.emplace_back([&, j]() {
+            bench::Pin(count + j);
+            Broadcast &broadcast = broadcasts[j % count];
+            for (int phase = 0;; phase ^= 1) {
+                WaitForEvent(broadcast.Phases[phase]);
+                if (stop.load(std::memory_order_relaxed)) {
+                    break;
+                }
+                latencies[j].push_back(Now() - broadcast.SetTime.load(std::memory_order_relaxed));
+                if (++broadcast.Woken == waitersPerEvent) {
+                    broadcast.Woken = 0;
+                    SetEvent(broadcast.Done);
+                }
+            }
+        });
+    }
+
+    double seconds = Measure(suite, stop);
+    // Waiters block without a timeout, as thousands of them timing out would swamp the CPUs
+    for (Broadcast &broadcast : broadcasts) {
+        SetEvent(broadcast.Phases[0]);
+        SetEvent(broadcast.Phases[1]);
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+    for (Broadcast &broadcast : broadcasts) {
+        DestroyEvent(broadcast.Phases[0]);
+        DestroyEvent(broadcast.Phases[1]);
+        DestroyEvent(broadcast.Done);
+    }
+
+    bench::Metrics metrics = Summarize(latencies, seconds);
+    metrics.insert(metrics.begin(), {"broadcasts_per_sec", sent / seconds});
+    suite.Record("broadcast_manual", {{"events", count}, {"waiters_per_event", waitersPerEvent}},
+                 metrics);
+}
+
+int main(int argc, const char *argv[]) {
+    bench::Suite suite("ScalingMatrix", argc, argv);
+
+    for (int setters : {1, 2, 4}) {
+        for (int waiters : {1, 4, 16}) {
+            for (int count : {1, 4, 16}) {
+                if (count <= waiters) {
+                    RunHandoff(suite, "handoff_auto", setters, waiters, count, false);
+                }
+            }
+        }
+    }
+
+    for (int count : {1, 4}) {
+        for (int waitersPerEvent : {1, 16, 256, 1024}) {
+            RunBroadcast(suite, count, waitersPerEvent);
+        }
+    }
+    RunBroadcast(suite, 1, 4096);
+
+#ifdef WFMO
+    for (int setters : {1, 4}) {
+        for (int waiters : {1, 4, 16}) {
+            for (int count : {4, 64}) {
+                RunHandoff(suite, "handoff_wfmo", setters, waiters, count, true);
+            }
+        }
+    }
+#endif
+    return 0;
+}
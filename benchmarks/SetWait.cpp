@@ -0,0 +1,50 @@
+// Measures the uncontended cost of the basic calls: sets and resets of events that no one is
+// waiting on, and waits that return without blocking.
+//
+// Usage: SetWait [repetitions]
+#include "bench.h"
+#include <pevents.h>
+
+using namespace neosmart;
+
+int main(int argc, const char *argv[]) {
+    bench::Suite suite("SetWait", argc, argv);
+    neosmart_event_t autoReset = CreateEvent(false, false);
+    neosmart_event_t manualReset = CreateEvent(true, false);
+
+    suite.Run("set_wait_auto", [&](uint64_t iterations) {
+        for (uint64_t i = 0; i < iterations; ++i) {
+            SetEvent(autoReset);
+            WaitForEvent(autoReset);
+        }
+    });
+    suite.Run("set_reset_manual", [&](uint64_t iterations) {
+        for (uint64_t i = 0; i < iterations; ++i) {
+            SetEvent(manualReset);
+            ResetEvent(manualReset);
+        }
+    });
+    suite.Run("redundant_set", [&](uint64_t iterations) {
+        SetEvent(manualReset);
+        for (uint64_t i = 0; i < iterations; ++i) {
+            SetEvent(manualReset);
+        }
+        ResetEvent(manualReset);
+    });
+    suite.Run("wait_signalled_manual", [&](uint64_t iterations) {
+        SetEvent(manualReset);
+        for (uint64_t i = 0; i < iterations; ++i) {
+            WaitForEvent(manualReset);
+        }
+        ResetEvent(manualReset);
+    });
+    suite.Run("wait_timeout_zero", [&](uint64_t iterations) {
+        for (uint64_t i = 0; i < iterations; ++i) {
+            WaitForEvent(autoReset, 0);
+        }
+    });
+
+    DestroyEvent(autoReset);
+    DestroyEvent(manualReset);
+    return 0;
+}
@@ -0,0 +1,110 @@
+// Measures how far past its deadline a wait that times out returns, by timeout, by the number of
+// threads timing out at once, and with every CPU idle or kept busy by spinning threads. Covers
+// WaitForEvent() and, with WFMO, WaitForMultipleEvents() on several events. Reports the p50 and
+// p99 of the error (the time waited less the timeout, negative for waits returning early), the
+// largest, and how many returned early.
+//
+// Usage: TimeoutAccuracy [repetitions]
+#include "bench.h"
+#include <atomic>
+#include <pevents.h>
+#include <thread>
+#include <vector>
+
+using namespace neosmart;
+
+static uint64_t Now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+// Events never set, for waits to time out on
+static const int EVENTS = 4;
+
+static void Run(bench::Suite &suite, const char *name, bool multiWait, uint64_t milliseconds,
+                int threads, int busyThreads) {
+    neosmart_event_t events[EVENTS];
+    for (neosmart_event_t &event : events) {
+        event = CreateEvent();
+    }
+    // Enough waits that the shorter timeouts are sampled well, without the longer ones taking
+    // too long
+    int waits = std::max(2, (int)(40 / milliseconds)) * suite.Repetitions();
+    std::vector<std::vector<double>> errors(threads);
+    std::atomic<bool> stop(false);
+
+    std::vector<std::thread> busy;
+    for (int i = 0; i < busyThreads; ++i) {
+        busy.emplace_back([&, i]() {
+            bench::Pin(i);
+            while (!stop.load(std::memory_order_relaxed)) {
+            }
+        });
+    }
+
+    std::vector<std::thread> waiters;
+    for (int j = 0; j < threads; ++j) {
+        waiters.emplace_back([&, j]() {
+            bench::Pin(j);
+            for (int i = 0; i < waits; ++i) {
+                uint64_t begin = Now();
+#ifdef WFMO
+                if (multiWait) {
+                    WaitForMultipleEvents(events, EVENTS, false, milliseconds);
+                } else
+#else
+                (void)multiWait;
+#endif
+                {
+                    WaitForEvent(events[0], milliseconds);
+                }
+                errors[j].push_back((double)(Now() - begin) - milliseconds * 1e6);
+            }
+        });
+    }
+    for (std::thread &waiter : waiters) {
+        waiter.join();
+    }
+    stop = true;
+    for (std::thread &thread : busy) {
+        thread.join();
+    }
+    for (neosmart_event_t event : events) {
+        DestroyEvent(event);
+    }
+
+    std::vector<double> all;
+    for (const std::vector<double> &thread : errors) {
+        all.insert(all.end(), thread.begin(), thread.end());
+    }
+    double early = 0;
+    for (double error : all) {
+        early += error < 0;
+    }
+    suite.Record(name,
+                 {{"timeout_ms", (int64_t)milliseconds},
+                  {"threads", threads},
+                  {"busy_threads", busyThreads}},
+                 {{"p50_error_ns", bench::Percentile(all, 0.5)},
+                  {"p99_error_ns", bench::Percentile(all, 0.99)},
+                  {"max_error_ns", all.empty() ? 0 : all.back()},
+                  {"early", early}});
+}
+
+int main(int argc, const char *argv[]) {
+    bench::Suite suite("TimeoutAccuracy", argc, argv);
+    const int cpus = std::max((int)std::thread::hardware_concurrency(), 1);
+
+    for (int busyThreads : {0, cpus}) {
+        for (int threads : {1, 4, 16}) {
+            for (uint64_t milliseconds : {1, 5, 20, 100}) {
+                Run(suite, "wait_timeout", false, milliseconds, threads, busyThreads);
+#ifdef WFMO
+                Run(suite, "wfmo_timeout", true, milliseconds, threads, busyThreads);
+#endif
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,57 @@
+// Measures WaitForMultipleEvents() calls that return without blocking, by the number of events
+// waited on and by the position of the signalled event among them. A wait-any registers with every
+// event ahead of the signalled one, so its cost grows with that position.
+//
+// Usage: WfmoScaling [repetitions]
+#include "bench.h"
+#include <pevents.h>
+#include <vector>
+
+using namespace neosmart;
+
+int main(int argc, const char *argv[]) {
+    bench::Suite suite("WfmoScaling", argc, argv);
+    const int maxCount = 4096;
+    std::vector<neosmart_event_t> events(maxCount);
+    CreateEvents(events.data(), maxCount, EVENT_MANUAL_RESET | EVENT_CACHE_ALIGNED);
+    int index;
+
+    for (int count = 1; count <= maxCount; count *= 2) {
+        SetEvent(events[count - 1]);
+        suite.Run("wait_any_last_signalled", {{"count", count}}, [&](uint64_t iterations) {
+            for (uint64_t i = 0; i < iterations; ++i) {
+                WaitForMultipleEvents(events.data(), count, false, -1ul, index);
+            }
+        });
+        ResetEvent(events[count - 1]);
+    }
+
+    for (int count = 1; count <= maxCount; count *= 2) {
+        for (int i = 0; i < count; ++i) {
+            SetEvent(events[i]);
+        }
+        suite.Run("wait_all_signalled", {{"count", count}}, [&](uint64_t iterations) {
+            for (uint64_t i = 0; i < iterations; ++i) {
+                WaitForMultipleEvents(events.data(), count, true, -1ul, index);
+            }
+        });
+        for (int i = 0; i < count; ++i) {
+            ResetEvent(events[i]);
+        }
+    }
+
+    const int count = 256;
+    for (int position : {0, count / 4, count / 2, count - 1}) {
+        SetEvent(events[position]);
+        suite.Run("wait_any_by_position", {{"count", count}, {"position", position}},
+                  [&](uint64_t iterations) {
+                      for (uint64_t i = 0; i < iterations; ++i) {
+                          WaitForMultipleEvents(events.data(), count, false, -1ul, index);
+                      }
+                  });
+        ResetEvent(events[position]);
+    }
+
+    DestroyEvents(events.data(), maxCount);
+    return 0;
+}
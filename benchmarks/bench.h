@@ -0,0 +1,185 @@
+// A small harness shared by the benchmarks. Each case is timed over enough iterations to take a
+// measurable while, repeated, and reported as one JSON document on stdout, so that runs against
+// different builds, options or releases can be compared by a script.
+//
+// Benchmarks using it take an optional repetition count as their first argument.
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <sstream>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string>
+#include <utility>
+#include <vector>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#endif
+
+namespace bench {
+    // Case parameters, reported as JSON numbers
+    typedef std::vector<std::pair<std::string, int64_t>> Params;
+    // Measurements of a case that isn't a simple cost per operation
+    typedef std::vector<std::pair<std::string, double>> Metrics;
+
+    // Pins the calling thread to the `index`th CPU (modulo the number of CPUs), where supported
+    inline void Pin(int index) {
+#ifdef __linux__
+        static const long cpus = std::max(sysconf(_SC_NPROCESSORS_ONLN), 1l);
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(index % cpus, &set);
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+        (void)index;
+#endif
+    }
+
+    // The `fraction` percentile of `samples`, which are sorted in the process
+    inline double Percentile(std::vector<double> &samples, double fraction) {
+        if (samples.empty()) {
+            return 0;
+        }
+        std::sort(samples.begin(), samples.end());
+        return samples[std::min((size_t)(fraction * samples.size()), samples.size() - 1)];
+    }
+
+    // The build options pevents was compiled with, which the results depend on
+    inline std::string Options() {
+        std::string options;
+        auto add = [&](const char *option) {
+            options += (options.empty() ? "\"" : ", \"") + std::string(option) + "\"";
+        };
+#ifdef WFMO
+        add("WFMO");
+#endif
+#ifdef PULSE
+        add("PULSE");
+#endif
+#ifdef NAMED
+        add("NAMED");
+#endif
+#ifdef HANDLES
+        add("HANDLES");
+#endif
+#ifdef NUMA
+        add("NUMA");
+#endif
+#ifdef STATS
+        add("STATS");
+#endif
+#ifdef LATENCY
+        add("LATENCY");
+#endif
+#ifdef CONTENTION
+        add("CONTENTION");
+#endif
+#ifdef TRACE
+        add("TRACE");
+#endif
+#ifdef REGISTRY
+        add("REGISTRY");
+#endif
+#ifdef WATCHDOG
+        add("WATCHDOG");
+#endif
+#ifdef ATTRIBUTION
+        add("ATTRIBUTION");
+#endif
+#ifdef CAPTURE
+        add("CAPTURE");
+#endif
+#ifdef USDT
+        add("USDT");
+#endif
+#ifdef PEVENTS_HEADER_ONLY
+        add("PEVENTS_HEADER_ONLY");
+#endif
+        (void)add;
+        return "[" + options + "]";
+    }
+
+    class Suite {
+    public:
+        Suite(const char *name, int argc, const char *argv[])
+            : Name(name), Runs(argc > 1 ? std::max(atoi(argv[1]), 1) : 5) {
+        }
+
+        ~Suite() {
+            std::cout << "{\n  \"suite\": \"" << Name << "\",\n  \"options\": " << Options()
+                      << ",\n  \"repetitions\": " << Runs << ",\n  \"results\": [";
+            for (size_t i = 0; i < Results.size(); ++i) {
+                std::cout << (i == 0 ? "\n    " : ",\n    ") << Results[i];
+            }
+            std::cout << "\n  ]\n}" << std::endl;
+        }
+
+        // Times `body(iterations)`, which must perform `iterations` times `batch` operations, and
+        // records the cost of one operation. The iteration count is doubled until a run takes at
+        // least 10ms.
+        template <typename Body>
+        void Run(const std::string &name, const Params &params, Body body, uint64_t batch = 1) {
+            uint64_t iterations = 1;
+            while (Time(body, iterations) < 10 * 1000 * 1000 && iterations < (1ull << 40)) {
+                iterations *= 2;
+            }
+            std::vector<double> samples;
+            for (int i = 0; i < Runs; ++i) {
+                samples.push_back(Time(body, iterations) / (iterations * batch));
+            }
+            std::sort(samples.begin(), samples.end());
+
+            std::ostringstream result;
+            result << "\"operations\": " << iterations * batch
+                   << ", \"ns_per_op\": {\"median\": " << samples[samples.size() / 2]
+                   << ", \"min\": " << samples.front() << ", \"max\": " << samples.back() << "}";
+            Add(name, params, result.str());
+        }
+
+        // Records a case measured by the benchmark itself
+        void Record(const std::string &name, const Params &params, const Metrics &metrics) {
+            std::ostringstream result;
+            for (size_t i = 0; i < metrics.size(); ++i) {
+                result << (i == 0 ? "" : ", ") << "\"" << metrics[i].first
+                       << "\": " << metrics[i].second;
+            }
+            Add(name, params, result.str());
+        }
+
+        int Repetitions() const {
+            return Runs;
+        }
+
+        template <typename Body> void Run(const std::string &name, Body body) {
+            Run(name, Params(), body);
+        }
+
+    private:
+        std::string Name;
+        int Runs;
+        std::vector<std::string> Results;
+
+        void Add(const std::string &name, const Params &params, const std::string &fields) {
+            std::ostringstream result;
+            result << "{\"name\": \"" << name << "\", \"params\": {";
+            for (size_t i = 0; i < params.size(); ++i) {
+                result << (i == 0 ? "" : ", ") << "\"" << params[i].first
+                       << "\": " << params[i].second;
+            }
+            result << "}, " << fields << "}";
+            Results.push_back(result.str());
+        }
+
+        // In nanoseconds
+        template <typename Body> static double Time(Body &body, uint64_t iterations) {
+            auto start = std::chrono::steady_clock::now();
+            body(iterations);
+            auto elapsed = std::chrono::steady_clock::now() - start;
+            return std::chrono::duration<double, std::nano>(elapsed).count();
+        }
+    };
+} // namespace bench
@@ -0,0 +1,1099 @@
+/*
+ * WIN32 Events for POSIX
+ * Author: Mahmoud Al-Qudsi <mqudsi@neosmart.net>
+ * Copyright (C) 2011 - 2019 by NeoSmart Technologies
+ * This code is released under the terms of the MIT License
+ */
+
+// The event implementation as a family of templates, for callers that know at compile time how
+// an event will be used. Each instantiation only carries the state and branches its policies call
+// for; the C-style API in pevents.h is a thin wrapper around one of them.
+
+#pragma once
+
+// Not available on Windows, where events are kernel objects
+#ifndef _WIN32
+
+#define PEVENTS_INCLUDING_BASIC_EVENT
+#include "pevents.h"
+#undef PEVENTS_INCLUDING_BASIC_EVENT
+#include <assert.h>
+#include <atomic>
+#include <errno.h>
+#include <new>
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/time.h>
+#include <time.h>
+#ifdef USDT
+#include <sys/sdt.h>
+#endif
+
+#if defined(NAMED) && (defined(__linux__) || defined(__FreeBSD__))
+#define PEVENTS_ROBUST_MUTEXES
+#endif
+
+// USDT probes (provider "pevents") for perf, bpftrace and friends, which are a single nop until a
+// tracer attaches to them. Events are identified by their address.
+#ifdef USDT
+#define PEVENTS_PROBE1(name, a) DTRACE_PROBE1(pevents, name, a)
+#define PEVENTS_PROBE2(name, a, b) DTRACE_PROBE2(pevents, name, a, b)
+#define PEVENTS_PROBE3(name, a, b, c) DTRACE_PROBE3(pevents, name, a, b, c)
+#define PEVENTS_PROBE4(name, a, b, c, d) DTRACE_PROBE4(pevents, name, a, b, c, d)
+#else
+#define PEVENTS_PROBE1(name, a) ((void)0)
+#define PEVENTS_PROBE2(name, a, b) ((void)0)
+#define PEVENTS_PROBE3(name, a, b, c) ((void)0)
+#define PEVENTS_PROBE4(name, a, b, c, d) ((void)0)
+#endif
+
+// Waits note what woke them up, for the features that need to know
+#if defined(LATENCY) || defined(TRACE) || defined(ATTRIBUTION)
+#define PEVENTS_WAKE_SAMPLES
+#endif
+
+namespace neosmart {
+    // Reset policies
+    struct auto_reset {
+        static constexpr bool AutoReset = true;
+    };
+
+    struct manual_reset {
+        static constexpr bool AutoReset = false;
+    };
+
+    // Chosen when the event is created, as for the C-style API
+    struct runtime_reset {
+        bool AutoReset;
+
+        constexpr explicit runtime_reset(bool autoReset = true) : AutoReset(autoReset) {
+        }
+    };
+
+    // Wait policies
+    struct blocking_wait {
+        static constexpr unsigned Spins = 0;
+    };
+
+    // Polls the event up to `SpinCount` times before blocking, trading CPU time for a faster
+    // wake-up when events are usually set shortly after a wait begins
+    template <unsigned SpinCount = 4000> struct spinning_wait {
+        static constexpr unsigned Spins = SpinCount;
+    };
+
+#ifdef ATTRIBUTION
+    namespace detail {
+        // Who set an event and when, as told by SetEventEx(); all zero for other sets
+        struct set_attribution {
+            uint64_t ThreadId;
+            uint64_t Time;
+            uint64_t Tag;
+        };
+
+        // The attribution of the SetEventEx() the calling thread is in the middle of, which is
+        // handed on to whoever it wakes
+        inline set_attribution &SetAttribution() {
+            static thread_local set_attribution attribution;
+            return attribution;
+        }
+    } // namespace detail
+#endif
+
+    struct neosmart_wfmo_t_;
+
+    // A neosmart_wfmo_info_t object is registered with each event waited on in a WFMO
+    // This reference to neosmart_wfmo_t_ is how the event knows whom to notify when triggered
+    struct neosmart_wfmo_info_t_ {
+        neosmart_wfmo_t_ *Waiter;
+        int WaitIndex;
+#ifdef NAMED
+        // The waiter's Generation when the wait was registered
+        uint32_t Generation;
+#endif
+    };
+    typedef neosmart_wfmo_info_t_ *neosmart_wfmo_info_t;
+
+    // Each call to WaitForMultipleObjects initializes a neosmart_wfmo_t object which tracks
+    // the progress of the caller's multi-object wait and dispatches responses accordingly.
+    // One neosmart_wfmo_t struct is shared for all events in a single WFMO call
+    struct neosmart_wfmo_t_ {
+        pthread_mutex_t Mutex;
+        pthread_cond_t CVariable;
+        int RefCount;
+        union {
+            int FiredEvent; // WFSO
+            int EventsLeft; // WFMO
+        } Status;
+        bool WaitAll;
+        bool StillWaiting;
+        const neosmart_allocator_t *Allocator;
+#ifdef NUMA
+        // The node the waiting thread was running on when it started waiting
+        int Node;
+#endif
+#ifdef PEVENTS_WAKE_SAMPLES
+        // When, how and by which event the waiter was last signalled
+#ifdef LATENCY
+        uint64_t SignalTime;
+#endif
+#ifdef TRACE
+        uint64_t SignalFlow;
+#endif
+#ifdef ATTRIBUTION
+        detail::set_attribution SignalBy;
+#endif
+        int SignalIndex;
+#endif
+#ifdef CONTENTION
+        // When the waiter took Mutex to register with its events
+        uint64_t HoldStart;
+#endif
+#ifdef REGISTRY
+        uint64_t ThreadId;
+#endif
+#ifdef WATCHDOG
+        // When the call started
+        uint64_t Since;
+#endif
+#ifdef NAMED
+        // Index into the process-shared WFMO pool, or -1 if this object lives on the heap
+        int Slot;
+        // Shared slots: the pid of the process using the slot, or 0 if it's free
+        std::atomic<uint32_t> InUse;
+        // Shared slots: when that process started, to tell it from a later one given the same pid,
+        // or 0 if not (yet) known
+        std::atomic<uint64_t> OwnerStart;
+        // Shared slots: bumped whenever the slot is taken back from a process that died using
+        // it, so that waits registered on its behalf are recognized as stale
+        uint32_t Generation;
+#endif
+
+        void Destroy() {
+            pthread_mutex_destroy(&Mutex);
+            pthread_cond_destroy(&CVariable);
+        }
+    };
+    typedef neosmart_wfmo_t_ *neosmart_wfmo_t;
+
+    // The WFMO waits registered with an event, in registration order. This stands in for a
+    // std::deque, which allocates even when empty: the array here is only allocated (through
+    // `Allocator`, or the default allocator if unset) once a WFMO wait is first registered, and is
+    // consumed from the front.
+    struct neosmart_wait_list_t_ {
+        neosmart_wfmo_info_t_ *Items = nullptr;
+        uint32_t Head = 0;
+        uint32_t Count = 0;
+        uint32_t Capacity = 0;
+        const neosmart_allocator_t *Allocator = nullptr;
+
+        bool Empty() const {
+            return Count == 0;
+        }
+
+        neosmart_wfmo_info_t_ *Begin() {
+            return Items + Head;
+        }
+
+        neosmart_wfmo_info_t_ *End() {
+            return Items + Head + Count;
+        }
+
+        neosmart_wfmo_info_t_ PopFront() {
+            neosmart_wfmo_info_t_ front = Items[Head++];
+            if (--Count == 0) {
+                Head = 0;
+            }
+            return front;
+        }
+
+        // Drops everything from `first` onwards
+        void Truncate(neosmart_wfmo_info_t_ *first) {
+            Count = (uint32_t)(first - Begin());
+            if (Count == 0) {
+                Head = 0;
+            }
+        }
+
+        bool PushBack(const neosmart_wfmo_info_t_ &info) {
+            if (Head + Count == Capacity) {
+                if (Head != 0) {
+                    // Reclaim the space left behind by consumed waits
+                    memmove(Items, Items + Head, Count * sizeof(Items[0]));
+                    Head = 0;
+                } else {
+                    if (Allocator == nullptr) {
+                        Allocator = GetDefaultAllocator();
+                    }
+                    uint32_t capacity = Capacity == 0 ? 4 : Capacity * 2;
+                    neosmart_wfmo_info_t_ *items =
+                        static_cast<neosmart_wfmo_info_t_ *>(Allocator->Allocate(
+                            capacity * sizeof(Items[0]), alignof(neosmart_wfmo_info_t_),
+                            Allocator->Context));
+                    if (items == nullptr) {
+                        return false;
+                    }
+                    if (Items != nullptr) {
+                        memcpy(items, Items, Count * sizeof(Items[0]));
+                        Allocator->Deallocate(Items, Capacity * sizeof(Items[0]),
+                                              alignof(neosmart_wfmo_info_t_), Allocator->Context);
+                    }
+                    Items = items;
+                    Capacity = capacity;
+                }
+            }
+            Items[Head + Count++] = info;
+            return true;
+        }
+
+#ifdef NUMA
+        // Moves the oldest wait by a thread on `node` to the front of the list
+        void PromoteNode(int node) {
+            for (uint32_t i = 0; i < Count; ++i) {
+                if (Items[Head + i].Waiter->Node == node) {
+                    neosmart_wfmo_info_t_ local = Items[Head + i];
+                    memmove(Items + Head + 1, Items + Head, i * sizeof(Items[0]));
+                    Items[Head] = local;
+                    return;
+                }
+            }
+        }
+#endif
+
+        void Release() {
+            if (Items != nullptr) {
+                Allocator->Deallocate(Items, Capacity * sizeof(Items[0]),
+                                      alignof(neosmart_wfmo_info_t_), Allocator->Context);
+            }
+            Items = nullptr;
+            Head = Count = Capacity = 0;
+        }
+    };
+
+    // The out-of-line halves of WFMO support, in pevents.cpp
+    namespace detail {
+        // Hands the event to the first registered waiter still waiting on it, returning false if
+        // there was none
+        PEVENTS_COLD bool SignalOneWaiter(neosmart_wait_list_t_ &waits);
+        PEVENTS_COLD void SignalAllWaiters(neosmart_wait_list_t_ &waits);
+        // Drops (and releases) the waits of WFMO calls that have since returned, returning how
+        // many were dropped
+        PEVENTS_COLD uint32_t RemoveExpiredWaits(neosmart_wait_list_t_ &waits);
+        // Returns a locked neosmart_wfmo_t_ ready for events to be registered with, or NULL
+        PEVENTS_COLD neosmart_wfmo_t AllocateWfmo(bool processShared, bool waitAll, int count);
+        // Waits (unless `done`) for the registered events and releases the caller's reference
+        PEVENTS_COLD int FinishWfmo(neosmart_wfmo_t wfmo, bool done, int result,
+                                    uint64_t milliseconds, int &index);
+    } // namespace detail
+
+#ifdef STATS
+    namespace detail {
+        // The counters behind neosmart_event_stats_t. Only ever updated with relaxed atomics; an
+        // event's counters share its cache line(s), which the event mutex has already pulled in.
+        struct event_counters {
+            std::atomic<uint64_t> Sets{0};
+            std::atomic<uint64_t> RedundantSets{0};
+            std::atomic<uint64_t> Resets{0};
+            std::atomic<uint64_t> Waits{0};
+            std::atomic<uint64_t> Timeouts{0};
+            std::atomic<uint64_t> SpuriousWakeups{0};
+            std::atomic<uint64_t> WfmoRegistrations{0};
+            std::atomic<uint64_t> ExpiredWaitsRemoved{0};
+            // Threads currently blocked in Wait(), and the most waiters (WFMO included) seen
+            std::atomic<uint64_t> Waiters{0};
+            std::atomic<uint64_t> PeakWaiters{0};
+
+            void Snapshot(neosmart_event_stats_t &stats) const;
+        };
+
+        // Global counters are striped across cache lines, with each thread updating its own
+        // stripe, so that counting doesn't make every event in the process contend on one line
+        struct alignas(PEVENTS_CACHE_LINE) event_counters_stripe {
+            event_counters Counters;
+        };
+
+        // Picks the stripe for the calling thread
+        PEVENTS_COLD event_counters &AssignGlobalCounters();
+
+        inline event_counters &GlobalCounters() {
+            static thread_local event_counters &counters = AssignGlobalCounters();
+            return counters;
+        }
+
+        inline void Count(event_counters &counters, std::atomic<uint64_t> event_counters::*counter,
+                          uint64_t amount = 1) {
+            (counters.*counter).fetch_add(amount, std::memory_order_relaxed);
+            (GlobalCounters().*counter).fetch_add(amount, std::memory_order_relaxed);
+        }
+
+        inline void RaisePeak(std::atomic<uint64_t> &peak, uint64_t waiters) {
+            uint64_t current = peak.load(std::memory_order_relaxed);
+            while (waiters > current &&
+                   !peak.compare_exchange_weak(current, waiters, std::memory_order_relaxed)) {
+            }
+        }
+
+        // Called with the event mutex held whenever a waiter is added
+        inline void CountWaiters(event_counters &counters, uint64_t waiters) {
+            if (waiters > counters.PeakWaiters.load(std::memory_order_relaxed)) {
+                counters.PeakWaiters.store(waiters, std::memory_order_relaxed);
+                RaisePeak(GlobalCounters().PeakWaiters, waiters);
+            }
+        }
+    } // namespace detail
+
+// Counts one `counter` for the event whose counters are `counters`, if built with STATS
+#define PEVENTS_COUNT(counters, counter)                                                           \
+    detail::Count((counters), &detail::event_counters::counter)
+#else
+#define PEVENTS_COUNT(counters, counter) ((void)0)
+#endif
+
+#ifdef PEVENTS_WAKE_SAMPLES
+    namespace detail {
+        // The wake-up sampled by the calling thread's last wait, if it blocked and was woken
+        struct wake_sample {
+#ifdef LATENCY
+            uint64_t Latency;
+#endif
+#ifdef TRACE
+            // The trace flow of the set that woke the wait
+            uint64_t Flow;
+#endif
+            // Of the event that woke a WFMO, into the array waited on
+            int Index;
+            bool Valid;
+#ifdef ATTRIBUTION
+            // The set the last successful wait returned on, whether or not it blocked
+            set_attribution SetBy;
+#endif
+        };
+
+        inline wake_sample &LastWake() {
+            static thread_local wake_sample sample;
+            return sample;
+        }
+    } // namespace detail
+#endif
+
+#ifdef TRACE
+    namespace detail {
+        // The flow of the SetEvent() the calling thread is in the middle of, if traced, which is
+        // handed on to whoever it wakes
+        inline uint64_t &TraceFlow() {
+            static thread_local uint64_t flow;
+            return flow;
+        }
+    } // namespace detail
+#endif
+
+#if defined(LATENCY) || defined(CONTENTION) || defined(REGISTRY) || defined(ATTRIBUTION) ||        \
+    defined(CAPTURE)
+    namespace detail {
+        inline uint64_t Now() {
+            timespec ts;
+            clock_gettime(CLOCK_MONOTONIC, &ts);
+            return (uint64_t)ts.tv_sec * 1000 * 1000 * 1000 + ts.tv_nsec;
+        }
+    } // namespace detail
+#endif
+
+#if defined(REGISTRY) || defined(ATTRIBUTION)
+    namespace detail {
+        PEVENTS_COLD uint64_t QueryThreadId();
+
+        inline uint64_t CurrentThreadId() {
+            static thread_local uint64_t id = QueryThreadId();
+            return id;
+        }
+    } // namespace detail
+#endif
+
+#ifdef REGISTRY
+    namespace detail {
+        // A thread blocked in Wait(), linked into the event's list of waiters (with the event
+        // mutex held) for as long as it waits
+        struct wfso_waiter {
+            uint64_t ThreadId;
+            uint64_t Since;
+            wfso_waiter *Next;
+        };
+
+        PEVENTS_COLD void UnregisterEvent(neosmart_event_t event);
+    } // namespace detail
+#endif
+
+#ifdef CONTENTION
+    namespace detail {
+        // Special values of an event's ProfileSlot
+        enum {
+            PROFILE_NONE = -1,
+            // Not profiled: the table is full, or the event is shared between processes
+            PROFILE_DISABLED = -2,
+        };
+
+        // The contention table, in pevents.cpp. Events are given a slot (with their mutex held)
+        // the first time their mutex is found contended, and are only timed from then on.
+        PEVENTS_COLD void RecordContention(std::atomic<int> &slot, const void *event, int op,
+                                           uint64_t wait);
+        void RecordHold(int slot, int op, uint64_t hold);
+        PEVENTS_COLD void RetireContention(int slot);
+    } // namespace detail
+#endif
+
+#ifdef LATENCY
+    namespace detail {
+        // Per-event latency histograms, in pevents.cpp. They're only allocated once the event
+        // first wakes a waiter.
+        struct latency_histogram;
+        PEVENTS_COLD void RecordLatency(std::atomic<latency_histogram *> &histogram,
+                                        const neosmart_allocator_t *allocator, uint64_t latency);
+        PEVENTS_COLD void FreeLatencies(latency_histogram *histogram);
+    } // namespace detail
+#endif
+
+    // Multi-wait policies
+    struct single_wait {
+        uint32_t RegisteredWaitCount() const {
+            return 0;
+        }
+    };
+
+    // Lets the event take part in WaitForMultipleEvents(), at the cost of tracking its waiters
+    struct multi_wait {
+        neosmart_wait_list_t_ RegisteredWaits;
+
+        uint32_t RegisteredWaitCount() const {
+            return RegisteredWaits.Count;
+        }
+
+        ~multi_wait() {
+            if (!RegisteredWaits.Empty()) {
+                detail::RemoveExpiredWaits(RegisteredWaits);
+            }
+            RegisteredWaits.Release();
+        }
+    };
+
+    namespace detail {
+        inline bool SignalOneWaiter(single_wait &) {
+            return false;
+        }
+
+        inline bool SignalOneWaiter(multi_wait &event) {
+            return !event.RegisteredWaits.Empty() && SignalOneWaiter(event.RegisteredWaits);
+        }
+
+        inline void SignalAllWaiters(single_wait &) {
+        }
+
+        inline void SignalAllWaiters(multi_wait &event) {
+            if (!event.RegisteredWaits.Empty()) {
+                SignalAllWaiters(event.RegisteredWaits);
+            }
+        }
+
+        inline timespec Deadline(uint64_t milliseconds) {
+            timeval tv;
+            gettimeofday(&tv, NULL);
+
+            uint64_t nanoseconds = ((uint64_t)tv.tv_sec) * 1000 * 1000 * 1000 +
+                                   milliseconds * 1000 * 1000 + ((uint64_t)tv.tv_usec) * 1000;
+
+            timespec ts;
+            ts.tv_sec = nanoseconds / 1000 / 1000 / 1000;
+            ts.tv_nsec = (long) (nanoseconds - ((uint64_t)ts.tv_sec) * 1000 * 1000 * 1000);
+            return ts;
+        }
+
+        // The mutexes of named events and of the shared WFMO pool are robust where supported:
+        // should a process die holding one, the next to lock it is told so with EOWNERDEAD and
+        // takes it over, along with whatever it protects as it was left. Passed the result of
+        // locking (or waiting on a condition variable with) `mutex`, returns 0 in that case too.
+        inline int Recover(pthread_mutex_t *mutex, int result) {
+#ifdef PEVENTS_ROBUST_MUTEXES
+            if (result == EOWNERDEAD) {
+                result = pthread_mutex_consistent(mutex);
+            }
+#else
+            (void)mutex;
+#endif
+            return result;
+        }
+
+        inline void CpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+            __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+            __asm__ __volatile__("yield");
+#endif
+        }
+    } // namespace detail
+
+    // An event whose behaviour is fixed by its policies:
+    //  * ResetPolicy: auto_reset, manual_reset or runtime_reset
+    //  * WaitPolicy: blocking_wait or spinning_wait<>
+    //  * MultiWaitPolicy: single_wait, or multi_wait to allow WaitForMultipleEvents()
+    // Events are neither copyable nor movable, as waiters may hold on to their address.
+    template <typename ResetPolicy, typename WaitPolicy = blocking_wait,
+              typename MultiWaitPolicy = single_wait>
+    struct basic_event : ResetPolicy, WaitPolicy, MultiWaitPolicy {
+        pthread_cond_t CVariable = PTHREAD_COND_INITIALIZER;
+        pthread_mutex_t Mutex = PTHREAD_MUTEX_INITIALIZER;
+        // Only written with Mutex held; read without it when spinning, by zero-timeout waits and
+        // by IsSet(). Sets store it with release ordering, so that a reader seeing it set also
+        // sees whatever was written before the set.
+        std::atomic<bool> State;
+#ifdef STATS
+        detail::event_counters Counters;
+#endif
+#ifdef LATENCY
+        // When the event was last set, on the (system-wide) monotonic clock
+        std::atomic<uint64_t> SetTime{0};
+#endif
+#ifdef TRACE
+        // The trace flow of the last set
+        std::atomic<uint64_t> SetFlow{0};
+#endif
+#ifdef ATTRIBUTION
+        // Only accessed with Mutex held
+        detail::set_attribution SetBy = {};
+#endif
+#ifdef REGISTRY
+        // Threads blocked in Wait(), which are only tracked for events local to this process
+        detail::wfso_waiter *WfsoWaiters = nullptr;
+        bool TrackWaiters = true;
+#endif
+#ifdef WATCHDOG
+        // The thread that last set the event, which the watchdog expects to set it again
+        std::atomic<uint64_t> LastSetter{0};
+#endif
+#ifdef CONTENTION
+        std::atomic<int> ProfileSlot{detail::PROFILE_NONE};
+        // When the current holder of Mutex took it, if the event is being profiled
+        uint64_t HoldStart = 0;
+#endif
+
+        // Both constructors are constexpr, so events with static storage duration are constant
+        // initialized: they're ready before any dynamic initialization runs, and cost nothing at
+        // startup.
+        constexpr explicit basic_event(bool initialState = false) : State(initialState) {
+        }
+
+        // For ResetPolicies (such as runtime_reset) that take arguments
+        constexpr basic_event(bool initialState, const ResetPolicy &reset)
+            : ResetPolicy(reset), State(initialState) {
+        }
+
+        basic_event(const basic_event &) = delete;
+        basic_event &operator=(const basic_event &) = delete;
+
+        ~basic_event() {
+#ifdef CONTENTION
+            int slot = ProfileSlot.load(std::memory_order_relaxed);
+            if (slot >= 0) {
+                detail::RetireContention(slot);
+            }
+#endif
+            int result = pthread_cond_destroy(&CVariable);
+            assert(result == 0);
+
+            result = pthread_mutex_destroy(&Mutex);
+            assert(result == 0);
+        }
+
+        // Takes Mutex on behalf of `op` (one of LOCK_OP_*), for which it's profiled with CONTENTION
+        void Lock(int op) {
+#ifdef CONTENTION
+            if (detail::Recover(&Mutex, pthread_mutex_trylock(&Mutex)) != 0) {
+                uint64_t start = detail::Now();
+                int result = detail::Recover(&Mutex, pthread_mutex_lock(&Mutex));
+                assert(result == 0);
+                detail::RecordContention(ProfileSlot, this, op, detail::Now() - start);
+            }
+            StartHold();
+#else
+            (void)op;
+            int result = detail::Recover(&Mutex, pthread_mutex_lock(&Mutex));
+            assert(result == 0);
+#endif
+        }
+
+        void Unlock(int op) {
+            EndHold(op);
+            int result = pthread_mutex_unlock(&Mutex);
+            assert(result == 0);
+        }
+
+        // Called with Mutex newly (re)acquired
+        void StartHold() {
+#ifdef CONTENTION
+            HoldStart = ProfileSlot.load(std::memory_order_relaxed) >= 0 ? detail::Now() : 0;
+#endif
+        }
+
+        // Called before letting go of Mutex
+        void EndHold(int op) {
+#ifdef CONTENTION
+            if (HoldStart != 0) {
+                detail::RecordHold(ProfileSlot.load(std::memory_order_relaxed), op,
+                                   detail::Now() - HoldStart);
+            }
+#else
+            (void)op;
+#endif
+        }
+
+        int Set() {
+            Lock(LOCK_OP_SET);
+
+            PEVENTS_COUNT(Counters, Sets);
+            if (State.load(std::memory_order_relaxed)) {
+                PEVENTS_COUNT(Counters, RedundantSets);
+            }
+#ifdef LATENCY
+            SetTime.store(detail::Now(), std::memory_order_relaxed);
+#endif
+#ifdef TRACE
+            SetFlow.store(detail::TraceFlow(), std::memory_order_relaxed);
+#endif
+#ifdef WATCHDOG
+            LastSetter.store(detail::CurrentThreadId(), std::memory_order_relaxed);
+#endif
+#ifdef ATTRIBUTION
+            SetBy = detail::SetAttribution();
+#endif
+
+            // Depending on the event type, we either trigger everyone or only one
+            if (this->AutoReset) {
+                // A WFMO waiter that takes the event consumes it, leaving it unset
+                bool consumed = detail::SignalOneWaiter(*this);
+                if (!consumed) {
+                    State.store(true, std::memory_order_release);
+                }
+
+                Unlock(LOCK_OP_SET);
+
+                if (!consumed) {
+                    int result = pthread_cond_signal(&CVariable);
+                    assert(result == 0);
+                }
+            } else {
+                State.store(true, std::memory_order_release);
+                detail::SignalAllWaiters(*this);
+
+                Unlock(LOCK_OP_SET);
+
+                int result = pthread_cond_broadcast(&CVariable);
+                assert(result == 0);
+            }
+
+            return 0;
+        }
+
+        int Reset() {
+            Lock(LOCK_OP_RESET);
+
+            PEVENTS_COUNT(Counters, Resets);
+            State.store(false, std::memory_order_relaxed);
+
+            Unlock(LOCK_OP_RESET);
+
+            return 0;
+        }
+
+        int Wait(uint64_t milliseconds = -1ul) {
+#ifdef PEVENTS_WAKE_SAMPLES
+            detail::LastWake().Valid = false;
+#endif
+            if (WaitPolicy::Spins != 0 && milliseconds != 0) {
+                for (unsigned i = 0; i < WaitPolicy::Spins; ++i) {
+                    if (State.load(std::memory_order_relaxed)) {
+                        break;
+                    }
+                    detail::CpuRelax();
+                }
+            }
+
+            // A zero-timeout wait on an unset event returns without touching Mutex. One on a set
+            // event takes it (blocking if it's busy, rather than reporting a timeout for an event
+            // that's set), to consume the event if auto-reset; it then only times out should
+            // another thread have taken the event in the meantime.
+            if (milliseconds == 0 && !State.load(std::memory_order_acquire)) {
+                PEVENTS_COUNT(Counters, Timeouts);
+                return WAIT_TIMEOUT;
+            }
+            Lock(LOCK_OP_WAIT);
+
+            int result = UnlockedWait(milliseconds);
+#ifdef STATS
+            if (result == 0) {
+                PEVENTS_COUNT(Counters, Waits);
+            } else if (result == WAIT_TIMEOUT) {
+                PEVENTS_COUNT(Counters, Timeouts);
+            }
+#endif
+
+            Unlock(LOCK_OP_WAIT);
+
+            return result;
+        }
+
+        // Whether the event is currently set, without taking Mutex or consuming it. The answer may
+        // be stale by the time it's acted on.
+        bool IsSet() const {
+            return State.load(std::memory_order_acquire);
+        }
+
+        // Waits with Mutex already held
+        int UnlockedWait(uint64_t milliseconds) {
+            int result = 0;
+            if (!State.load(std::memory_order_relaxed)) {
+                // Zero-timeout event state check optimization
+                if (milliseconds == 0) {
+                    return WAIT_TIMEOUT;
+                }
+
+                timespec ts;
+                if (milliseconds != -1ul) {
+                    ts = detail::Deadline(milliseconds);
+                }
+
+#ifdef STATS
+                uint64_t waiters = Counters.Waiters.load(std::memory_order_relaxed) + 1;
+                Counters.Waiters.store(waiters, std::memory_order_relaxed);
+                detail::CountWaiters(Counters, waiters + this->RegisteredWaitCount());
+                bool woken = false;
+#endif
+#ifdef REGISTRY
+                detail::wfso_waiter self = {detail::CurrentThreadId(), detail::Now(), WfsoWaiters};
+                if (TrackWaiters) {
+                    WfsoWaiters = &self;
+                }
+#endif
+                // Mutex is let go of while waiting, which ends this hold of it
+                EndHold(LOCK_OP_WAIT);
+                do {
+#ifdef STATS
+                    // Woken up, only to find the event unset (or taken by someone else)
+                    if (woken) {
+                        PEVENTS_COUNT(Counters, SpuriousWakeups);
+                    }
+                    woken = true;
+#endif
+                    // Regardless of whether it's an auto-reset or manual-reset event:
+                    // wait to obtain the event, then lock anyone else out
+                    if (milliseconds != -1ul) {
+                        result = pthread_cond_timedwait(&CVariable, &Mutex, &ts);
+                    } else {
+                        result = pthread_cond_wait(&CVariable, &Mutex);
+                    }
+                    result = detail::Recover(&Mutex, result);
+                } while (result == 0 && !State.load(std::memory_order_relaxed));
+                StartHold();
+#ifdef REGISTRY
+                if (TrackWaiters) {
+                    detail::wfso_waiter **link = &WfsoWaiters;
+                    while (*link != &self) {
+                        link = &(*link)->Next;
+                    }
+                    *link = self.Next;
+                }
+#endif
+#ifdef STATS
+                Counters.Waiters.store(waiters - 1, std::memory_order_relaxed);
+#endif
+
+                if (result == 0 && this->AutoReset) {
+                    // We've only accquired the event if the wait succeeded
+                    State.store(false, std::memory_order_relaxed);
+                }
+#ifdef PEVENTS_WAKE_SAMPLES
+                if (result == 0) {
+                    detail::wake_sample &sample = detail::LastWake();
+#ifdef LATENCY
+                    sample.Latency = detail::Now() - SetTime.load(std::memory_order_relaxed);
+#endif
+#ifdef TRACE
+                    sample.Flow = SetFlow.load(std::memory_order_relaxed);
+#endif
+                    sample.Index = 0;
+                    sample.Valid = true;
+                }
+#endif
+            } else if (this->AutoReset) {
+                // It's an auto-reset event that's currently available;
+                // we need to stop anyone else from using it
+                State.store(false, std::memory_order_relaxed);
+            }
+            // Else we're trying to obtain a manual reset event with a signaled state;
+            // don't do anything
+#ifdef ATTRIBUTION
+            if (result == 0) {
+                detail::LastWake().SetBy = SetBy;
+            }
+#endif
+
+            return result;
+        }
+
+        // Registers a WFMO wait with the event, unless it can be had right away. Sets `signaled`
+        // in that case; returns ENOMEM if the wait couldn't be registered.
+        int RegisterWait(const neosmart_wfmo_info_t_ &info, bool &signaled) {
+            Lock(LOCK_OP_REGISTER);
+
+            // Before adding this wait to the list of registered waits, let's clean up old, expired
+            // waits while we have the event lock anyway
+            if (!this->RegisteredWaits.Empty()) {
+                uint32_t removed = detail::RemoveExpiredWaits(this->RegisteredWaits);
+#ifdef STATS
+                detail::Count(Counters, &detail::event_counters::ExpiredWaitsRemoved, removed);
+#else
+                (void)removed;
+#endif
+            }
+
+            int error = 0;
+            signaled = UnlockedWait(0) == 0;
+            if (!signaled) {
+                if (!this->RegisteredWaits.PushBack(info)) {
+                    error = ENOMEM;
+                } else {
+                    PEVENTS_COUNT(Counters, WfmoRegistrations);
+#ifdef STATS
+                    uint64_t waiters = Counters.Waiters.load(std::memory_order_relaxed);
+                    detail::CountWaiters(Counters, waiters + this->RegisteredWaits.Count);
+#endif
+                }
+            }
+
+            Unlock(LOCK_OP_REGISTER);
+
+            return error;
+        }
+    };
+
+    namespace detail {
+        template <typename Event>
+        int WaitForMultiple(Event *const *events, int count, bool waitAll, uint64_t milliseconds,
+                            int &index, bool processShared) {
+#ifdef PEVENTS_WAKE_SAMPLES
+            LastWake().Valid = false;
+#endif
+            neosmart_wfmo_t wfmo = AllocateWfmo(processShared, waitAll, count);
+            if (wfmo == NULL) {
+                return ENOMEM;
+            }
+
+            int result = 0;
+            bool done = false;
+            index = -1;
+
+            for (int i = 0; i < count; ++i) {
+                neosmart_wfmo_info_t_ waitInfo;
+                waitInfo.Waiter = wfmo;
+                waitInfo.WaitIndex = i;
+#ifdef NAMED
+                waitInfo.Generation = wfmo->Generation;
+#endif
+
+                bool signaled = false;
+                result = events[i]->RegisterWait(waitInfo, signaled);
+                PEVENTS_PROBE4(wfmo_register, wfmo, events[i], i, signaled);
+                if (result != 0) {
+                    // Any waits already registered will be reaped as expired
+                    done = true;
+                    break;
+                }
+
+                if (!signaled) {
+                    ++wfmo->RefCount;
+                } else if (waitAll) {
+                    --wfmo->Status.EventsLeft;
+                    assert(wfmo->Status.EventsLeft >= 0);
+                } else {
+                    wfmo->Status.FiredEvent = i;
+                    done = true;
+                    break;
+                }
+            }
+
+            return FinishWfmo(wfmo, done, result, milliseconds, index);
+        }
+    } // namespace detail
+
+    // WaitForMultipleEvents() for events of the same (multi_wait) type
+    template <typename ResetPolicy, typename WaitPolicy>
+    int WaitForMultipleEvents(basic_event<ResetPolicy, WaitPolicy, multi_wait> *const *events,
+                              int count, bool waitAll, uint64_t milliseconds, int &index) {
+        return detail::WaitForMultiple(events, count, waitAll, milliseconds, index, false);
+    }
+
+    template <typename ResetPolicy, typename WaitPolicy>
+    int WaitForMultipleEvents(basic_event<ResetPolicy, WaitPolicy, multi_wait> *const *events,
+                              int count, bool waitAll, uint64_t milliseconds) {
+        int unused;
+        return WaitForMultipleEvents(events, count, waitAll, milliseconds, unused);
+    }
+
+#ifdef NAMED
+    struct neosmart_shared_event_t_;
+#endif
+
+    // The basic event structure, passed to the caller as an opaque pointer when creating events
+#ifdef WFMO
+    struct neosmart_event_t_ : basic_event<runtime_reset, blocking_wait, multi_wait> {
+#else
+    struct neosmart_event_t_ : basic_event<runtime_reset, blocking_wait, single_wait> {
+#endif
+        const neosmart_allocator_t *Allocator = nullptr;
+        // For events made by CreateEvents(), one more than their position in the block
+        uint32_t BlockIndex = 0;
+#ifdef LATENCY
+        std::atomic<detail::latency_histogram *> Latencies{nullptr};
+#endif
+#ifdef REGISTRY
+        // Links in the registry of live events, guarded by its mutex, as is the debug name
+        neosmart_event_t_ *RegistryPrev = nullptr;
+        neosmart_event_t_ *RegistryNext = nullptr;
+        bool Registered = false;
+        char DebugName[PEVENTS_DEBUG_NAME_LENGTH] = {};
+#endif
+#ifdef CAPTURE
+        // The event's id in the running capture, tagged with that capture's generation
+        std::atomic<uint64_t> CaptureId{0};
+#endif
+#ifdef NAMED
+        // Non-null for named events, in which case only this mapping is used for the event state
+        neosmart_shared_event_t_ *Shared = nullptr;
+        char *SharedName = nullptr;
+#ifdef WFMO
+        // Also registers waits with named events
+        PEVENTS_COLD int RegisterWait(const neosmart_wfmo_info_t_ &info, bool &signaled);
+#endif
+#endif
+
+        // Events can also be declared directly, as globals or members, in which case they need no
+        // runtime initialization (PTHREAD_MUTEX_INITIALIZER style) and allocate nothing (besides
+        // what LATENCY, TRACE and CAPTURE allocate when they're used). Pass their address to the
+        // API as usual, except DestroyEvent(): they're torn down by their destructor instead.
+        constexpr explicit neosmart_event_t_(bool manualReset = false, bool initialState = false)
+            : basic_event(initialState, runtime_reset(!manualReset)) {
+        }
+
+#if defined(LATENCY) || defined(REGISTRY)
+        ~neosmart_event_t_() {
+#ifdef REGISTRY
+            if (Registered) {
+                detail::UnregisterEvent(this);
+            }
+#endif
+#ifdef LATENCY
+            detail::latency_histogram *latencies = Latencies.load(std::memory_order_relaxed);
+            if (latencies != nullptr) {
+                detail::FreeLatencies(latencies);
+            }
+#endif
+        }
+#endif
+
+#ifdef LATENCY
+        // Adds the calling thread's last wake-up, if it was woken by this event
+        void RecordWake() {
+            if (detail::LastWake().Valid) {
+                detail::RecordLatency(Latencies, Allocator, detail::LastWake().Latency);
+            }
+        }
+#endif
+    };
+
+    // An owning C++ event whose storage lives inline in the Event itself, so that creating one
+    // allocates nothing and signalling or waiting on one doesn't chase a pointer. native() returns
+    // the event for use with the C-style API (WFMO included); never pass it to DestroyEvent().
+    //
+    // Events are move-only. Moving one carries over its reset mode and state, leaving the source
+    // unset; as waiters hold on to an event's address, no thread may be using either side.
+    //
+    // With any of the options recorded by the C-style entry points (LATENCY, TRACE, CAPTURE and
+    // USDT) enabled, Set(), Reset() and Wait() go through them, so that events are recorded alike
+    // however they're used.
+#if defined(LATENCY) || defined(TRACE) || defined(CAPTURE) || defined(USDT)
+#define PEVENTS_EVENT_ENTRY_POINTS
+#endif
+    class Event {
+    public:
+        constexpr explicit Event(bool manualReset = false, bool initialState = false)
+            : Storage(manualReset, initialState) {
+        }
+
+        Event(Event &&other) noexcept : Storage(!other.Storage.AutoReset, other.Take()) {
+        }
+
+        Event &operator=(Event &&other) noexcept {
+            if (this != &other) {
+                bool manualReset = !other.Storage.AutoReset;
+                bool state = other.Take();
+                Storage.~neosmart_event_t_();
+                new (&Storage) neosmart_event_t_(manualReset, state);
+            }
+            return *this;
+        }
+
+        Event(const Event &) = delete;
+        Event &operator=(const Event &) = delete;
+
+        int Set() {
+#ifdef PEVENTS_EVENT_ENTRY_POINTS
+            return SetEvent(&Storage);
+#else
+            return Storage.Set();
+#endif
+        }
+
+        int Reset() {
+#ifdef PEVENTS_EVENT_ENTRY_POINTS
+            return ResetEvent(&Storage);
+#else
+            return Storage.Reset();
+#endif
+        }
+
+        int Wait(uint64_t milliseconds = -1ul) {
+#ifdef PEVENTS_EVENT_ENTRY_POINTS
+            return WaitForEvent(&Storage, milliseconds);
+#else
+            return Storage.Wait(milliseconds);
+#endif
+        }
+
+        bool IsSet() const {
+            return Storage.IsSet();
+        }
+
+        neosmart_event_t native() {
+            return &Storage;
+        }
+
+    private:
+        neosmart_event_t_ Storage;
+
+        // Returns the current state, leaving the event unset
+        bool Take() {
+            int result = pthread_mutex_lock(&Storage.Mutex);
+            assert(result == 0);
+
+            bool state = Storage.State.exchange(false, std::memory_order_relaxed);
+
+            result = pthread_mutex_unlock(&Storage.Mutex);
+            assert(result == 0);
+
+            return state;
+        }
+    };
+} // namespace neosmart
+
+#ifdef PEVENTS_HEADER_ONLY
+#include "pevents.cpp"
+#endif
+
+#endif // _WIN32
@@ -0,0 +1,78 @@
+/*
+ * WIN32 Events for POSIX
+ * Author: Mahmoud Al-Qudsi <mqudsi@neosmart.net>
+ * Copyright (C) 2011 - 2019 by NeoSmart Technologies
+ * This code is released under the terms of the MIT License
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+namespace neosmart {
+    // The format of a capture, as written with CAPTURE and read back by tools/replay.cpp. A
+    // capture is a neosmart_capture_header_t followed by records, each WFMO record being followed
+    // in turn by the ids of the events it waited on (one uint32_t each). Fields are in host byte
+    // order.
+    //
+    // Threads and events are identified by numbers from 1 up. Every event has a CAPTURE_CREATE
+    // record: made when it's created, or for events that already existed when the capture started,
+    // when it's first used. Records are grouped by thread, each thread's in the order it made them,
+    // so a thread may use an event before the record of another thread creating it.
+    enum {
+        CAPTURE_VERSION = 1,
+    };
+
+    enum {
+        CAPTURE_CREATE,
+        CAPTURE_DESTROY,
+        CAPTURE_SET,
+        CAPTURE_RESET,
+        CAPTURE_WAIT,
+        CAPTURE_WFMO,
+    };
+
+    // Record flags
+    enum {
+        // Creates: the event is manual-reset
+        CAPTURE_MANUAL_RESET = 1,
+        // Creates: the event was set when created (or first seen)
+        CAPTURE_INITIAL_STATE = 2,
+        // WFMO: waited for all of the events
+        CAPTURE_WAIT_ALL = 4,
+        // Creates: the event is named, and may be set and waited on by other processes
+        CAPTURE_NAMED = 8,
+    };
+
+    struct neosmart_capture_header_t {
+        char Magic[8]; // "pevents\0"
+        uint32_t Version;
+        uint32_t RecordSize;
+    };
+
+    struct neosmart_capture_record_t {
+        // When the call was made and how long it took, in nanoseconds since the capture started
+        uint64_t Begin;
+        uint64_t Duration;
+        // Waits: the timeout passed, in milliseconds
+        uint64_t Timeout;
+        uint32_t Thread;
+        // The event, or for WFMO the one that woke the wait (if any, and otherwise the first)
+        uint32_t Event;
+        int32_t Result;
+        // WFMO: the number of events waited on, whose ids follow the record
+        uint32_t Count;
+        uint8_t Op;
+        uint8_t Flags;
+        uint16_t Reserved;
+    };
+
+#ifdef CAPTURE
+    // Starts recording every event created, destroyed, set, reset or waited on to `path`.
+    // Returns 0, EBUSY if a capture is already running, or an errno value.
+    int StartCapture(const char *path);
+    // Writes out whatever has yet to be and closes the capture. Calls still in progress may be
+    // left out. Returns 0, ESRCH if no capture is running, or an errno value.
+    int StopCapture();
+#endif
+} // namespace neosmart
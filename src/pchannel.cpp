@@ -0,0 +1,321 @@
+/*
+ * WIN32 Events for POSIX
+ * Author: Mahmoud Al-Qudsi <mqudsi@neosmart.net>
+ * Copyright (C) 2011 - 2019 by NeoSmart Technologies
+ * This code is released under the terms of the MIT License
+ */
+
+#if !defined(_WIN32) && defined(NAMED)
+
+#include "pchannel.h"
+#include <assert.h>
+#include <atomic>
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace neosmart {
+    enum { CHANNEL_EMPTY = 0, CHANNEL_READY = 1 };
+    enum { CHANNEL_NAME_MAX = 256 };
+
+    // Each message is preceded by its length, padded so that payloads are 8-byte aligned. A
+    // message that would straddle the end of the ring is instead preceded by a padding record.
+    static const uint32_t RECORD_HEADER = 8;
+    static const uint32_t PADDING_RECORD = 0xFFFFFFFF;
+
+    PEVENTS_LOCAL uint64_t RecordSize(uint32_t size) {
+        return (RECORD_HEADER + (uint64_t)size + 7) & ~(uint64_t)7;
+    }
+
+    // The header of the shared segment; the ring itself follows. Producer- and consumer-owned
+    // fields are kept on separate cache lines.
+    struct neosmart_channel_header_t_ {
+        std::atomic<uint32_t> Initialized;
+        std::atomic<uint32_t> OpenCount;
+        uint32_t Capacity;
+
+        alignas(64) std::atomic<uint64_t> Head; // Committed by the producer
+        std::atomic<uint32_t> ProducerWaiting;
+
+        alignas(64) std::atomic<uint64_t> Tail; // Released by the consumer
+        std::atomic<uint32_t> ConsumerWaiting;
+
+        alignas(64) char Data[1];
+    };
+
+    struct neosmart_channel_t_ {
+        const neosmart_allocator_t *Allocator;
+        neosmart_channel_header_t_ *Header;
+        size_t MappedSize;
+        char Name[CHANNEL_NAME_MAX];
+        neosmart_event_t DataReady;
+        neosmart_event_t SpaceReady;
+
+        // Producer-local state
+        uint64_t Reserved;
+        uint64_t CachedTail;
+        // Consumer-local state
+        uint64_t ReadPosition;
+        uint64_t CachedHead;
+    };
+
+    PEVENTS_LOCAL size_t SegmentSize(uint32_t capacity) {
+        return offsetof(neosmart_channel_header_t_, Data) + capacity;
+    }
+
+    PEVENTS_LOCAL bool WaitForSize(int fd, size_t size) {
+        struct stat st;
+        while (fstat(fd, &st) == 0) {
+            if ((size_t)st.st_size >= size) {
+                return true;
+            }
+            sched_yield();
+        }
+        return false;
+    }
+
+    // Undoes the mapping of a channel that couldn't be opened, removing its segment as well if
+    // this process created it and no other has opened it since
+    PEVENTS_LOCAL void UnmapChannel(const char *shmName, bool created, void *mapping, size_t size) {
+        neosmart_channel_header_t_ *header = static_cast<neosmart_channel_header_t_ *>(mapping);
+        if (created && header->OpenCount.load() == 0) {
+            shm_unlink(shmName);
+        }
+        munmap(mapping, size);
+    }
+
+    PEVENTS_LOCAL neosmart_channel_t MapChannel(const char *name, bool create, uint32_t capacity) {
+        char shmName[CHANNEL_NAME_MAX];
+        if (snprintf(shmName, sizeof(shmName), "/pchannel.%s", name) >= (int)sizeof(shmName)) {
+            return NULL;
+        }
+        int fd = create ? shm_open(shmName, O_RDWR | O_CREAT | O_EXCL, 0666) : -1;
+        bool created = fd >= 0;
+        if (!created) {
+            fd = shm_open(shmName, O_RDWR, 0666);
+        }
+        if (fd < 0) {
+            return NULL;
+        }
+
+        if (created) {
+            uint32_t rounded = 4096;
+            while (rounded < capacity) {
+                rounded <<= 1;
+            }
+            capacity = rounded;
+
+            if (ftruncate(fd, SegmentSize(capacity)) != 0) {
+                close(fd);
+                shm_unlink(shmName);
+                return NULL;
+            }
+        }
+
+        // Map just the header until we know the real capacity
+        if (!WaitForSize(fd, sizeof(neosmart_channel_header_t_))) {
+            close(fd);
+            return NULL;
+        }
+        void *mapping = mmap(NULL, sizeof(neosmart_channel_header_t_), PROT_READ | PROT_WRITE,
+                             MAP_SHARED, fd, 0);
+        if (mapping == MAP_FAILED) {
+            close(fd);
+            return NULL;
+        }
+
+        neosmart_channel_header_t_ *header = static_cast<neosmart_channel_header_t_ *>(mapping);
+        if (created) {
+            header->Capacity = capacity;
+            header->Initialized.store(CHANNEL_READY, std::memory_order_release);
+        }
+        while (header->Initialized.load(std::memory_order_acquire) != CHANNEL_READY) {
+            sched_yield();
+        }
+        capacity = header->Capacity;
+        munmap(mapping, sizeof(neosmart_channel_header_t_));
+
+        size_t size = SegmentSize(capacity);
+        mapping = WaitForSize(fd, size)
+                      ? mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)
+                      : MAP_FAILED;
+        close(fd);
+        if (mapping == MAP_FAILED) {
+            return NULL;
+        }
+
+        const neosmart_allocator_t *allocator = GetDefaultAllocator();
+        neosmart_channel_t channel = static_cast<neosmart_channel_t>(allocator->Allocate(
+            sizeof(neosmart_channel_t_), alignof(neosmart_channel_t_), allocator->Context));
+        if (channel == NULL) {
+            UnmapChannel(shmName, created, mapping, size);
+            return NULL;
+        }
+
+        char eventName[sizeof(shmName) + 8];
+        channel->Allocator = allocator;
+        channel->Header = static_cast<neosmart_channel_header_t_ *>(mapping);
+        channel->MappedSize = size;
+        memcpy(channel->Name, shmName, sizeof(shmName));
+        snprintf(eventName, sizeof(eventName), "%s.data", shmName);
+        channel->DataReady = CreateEvent(eventName, false, false);
+        snprintf(eventName, sizeof(eventName), "%s.space", shmName);
+        channel->SpaceReady = CreateEvent(eventName, false, false);
+        if (channel->DataReady == NULL || channel->SpaceReady == NULL) {
+            int error = errno;
+            if (channel->DataReady != NULL) {
+                DestroyEvent(channel->DataReady);
+            }
+            if (channel->SpaceReady != NULL) {
+                DestroyEvent(channel->SpaceReady);
+            }
+            allocator->Deallocate(channel, sizeof(neosmart_channel_t_),
+                                  alignof(neosmart_channel_t_), allocator->Context);
+            UnmapChannel(shmName, created, mapping, size);
+            errno = error;
+            return NULL;
+        }
+
+        channel->Header->OpenCount.fetch_add(1);
+        channel->Reserved = channel->Header->Head.load(std::memory_order_acquire);
+        channel->CachedTail = channel->Header->Tail.load(std::memory_order_acquire);
+        channel->ReadPosition = channel->CachedTail;
+        channel->CachedHead = channel->Reserved;
+
+        return channel;
+    }
+
+    PEVENTS_DECL neosmart_channel_t CreateChannel(const char *name, uint32_t capacity) {
+        return MapChannel(name, true, capacity);
+    }
+
+    PEVENTS_DECL neosmart_channel_t OpenChannel(const char *name) {
+        return MapChannel(name, false, 0);
+    }
+
+    PEVENTS_DECL int DestroyChannel(neosmart_channel_t channel) {
+        if (channel->Header->OpenCount.fetch_sub(1) == 1) {
+            shm_unlink(channel->Name);
+        }
+
+        DestroyEvent(channel->DataReady);
+        DestroyEvent(channel->SpaceReady);
+        munmap(channel->Header, channel->MappedSize);
+        channel->Allocator->Deallocate(channel, sizeof(neosmart_channel_t_),
+                                       alignof(neosmart_channel_t_), channel->Allocator->Context);
+
+        return 0;
+    }
+
+    PEVENTS_DECL void *ChannelReserve(neosmart_channel_t channel, uint32_t size,
+                                      uint64_t milliseconds) {
+        neosmart_channel_header_t_ *header = channel->Header;
+        const uint64_t capacity = header->Capacity;
+
+        uint64_t record = RecordSize(size);
+        if (record > capacity / 2) {
+            return NULL;
+        }
+
+        uint64_t offset = channel->Reserved & (capacity - 1);
+        uint64_t padding = capacity - offset < record ? capacity - offset : 0;
+        uint64_t end = channel->Reserved + padding + record;
+
+        while (end - channel->CachedTail > capacity) {
+            channel->CachedTail = header->Tail.load(std::memory_order_acquire);
+            if (end - channel->CachedTail <= capacity) {
+                break;
+            }
+
+            // Announce that we're about to park before checking one last time; the consumer
+            // checks the flag after publishing its new tail, so one of us sees the other.
+            header->ProducerWaiting.store(1);
+            channel->CachedTail = header->Tail.load();
+            if (end - channel->CachedTail <= capacity) {
+                header->ProducerWaiting.store(0, std::memory_order_relaxed);
+                break;
+            }
+            if (WaitForEvent(channel->SpaceReady, milliseconds) == WAIT_TIMEOUT) {
+                header->ProducerWaiting.store(0, std::memory_order_relaxed);
+                return NULL;
+            }
+        }
+
+        if (padding != 0) {
+            memcpy(header->Data + offset, &PADDING_RECORD, sizeof(PADDING_RECORD));
+            offset = 0;
+        }
+        memcpy(header->Data + offset, &size, sizeof(size));
+        channel->Reserved = end;
+
+        return header->Data + offset + RECORD_HEADER;
+    }
+
+    PEVENTS_DECL int ChannelCommit(neosmart_channel_t channel) {
+        neosmart_channel_header_t_ *header = channel->Header;
+        header->Head.store(channel->Reserved);
+
+        // Only signal if the consumer found the ring empty and parked (or is about to)
+        if (header->ConsumerWaiting.load() != 0 && header->ConsumerWaiting.exchange(0) != 0) {
+            return SetEvent(channel->DataReady);
+        }
+
+        return 0;
+    }
+
+    PEVENTS_DECL const void *ChannelRead(neosmart_channel_t channel, uint32_t &size,
+                                         uint64_t milliseconds) {
+        neosmart_channel_header_t_ *header = channel->Header;
+        const uint64_t capacity = header->Capacity;
+
+        while (true) {
+            if (channel->ReadPosition == channel->CachedHead) {
+                channel->CachedHead = header->Head.load(std::memory_order_acquire);
+            }
+            if (channel->ReadPosition == channel->CachedHead) {
+                header->ConsumerWaiting.store(1);
+                channel->CachedHead = header->Head.load();
+                if (channel->ReadPosition != channel->CachedHead) {
+                    header->ConsumerWaiting.store(0, std::memory_order_relaxed);
+                    continue;
+                }
+                if (WaitForEvent(channel->DataReady, milliseconds) == WAIT_TIMEOUT) {
+                    header->ConsumerWaiting.store(0, std::memory_order_relaxed);
+                    return NULL;
+                }
+                continue;
+            }
+
+            uint64_t offset = channel->ReadPosition & (capacity - 1);
+            uint32_t length;
+            memcpy(&length, header->Data + offset, sizeof(length));
+            if (length == PADDING_RECORD) {
+                channel->ReadPosition += capacity - offset;
+                continue;
+            }
+
+            size = length;
+            channel->ReadPosition += RecordSize(length);
+            return header->Data + offset + RECORD_HEADER;
+        }
+    }
+
+    PEVENTS_DECL int ChannelRelease(neosmart_channel_t channel) {
+        neosmart_channel_header_t_ *header = channel->Header;
+        header->Tail.store(channel->ReadPosition);
+
+        if (header->ProducerWaiting.load() != 0 && header->ProducerWaiting.exchange(0) != 0) {
+            return SetEvent(channel->SpaceReady);
+        }
+
+        return 0;
+    }
+} // namespace neosmart
+
+#endif // !_WIN32 && NAMED
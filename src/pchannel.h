@@ -0,0 +1,46 @@
+/*
+ * WIN32 Events for POSIX
+ * Author: Mahmoud Al-Qudsi <mqudsi@neosmart.net>
+ * Copyright (C) 2011 - 2019 by NeoSmart Technologies
+ * This code is released under the terms of the MIT License
+ */
+
+#pragma once
+
+#include "pevents.h"
+#include <stdint.h>
+
+#if !defined(NAMED)
+#error pchannel requires pevents to be compiled with NAMED support
+#endif
+
+namespace neosmart {
+    // A single-producer, single-consumer message ring in shared memory, usable across processes.
+    // Readiness is signalled through named pevents events, and only when the other side is
+    // actually parked waiting for data (or space), so a busy channel makes no syscalls at all.
+    struct neosmart_channel_t_;
+    typedef neosmart_channel_t_ *neosmart_channel_t;
+
+    // Creates the named channel, or opens it if it already exists. `capacity` is rounded up to a
+    // power of two, and a single message may occupy at most half of it.
+    neosmart_channel_t CreateChannel(const char *name, uint32_t capacity);
+    neosmart_channel_t OpenChannel(const char *name);
+    int DestroyChannel(neosmart_channel_t channel);
+
+    // Producer side: reserve space for a message and write it in place. Reserved messages become
+    // visible to the consumer in one go upon ChannelCommit(), allowing writes to be batched.
+    // Returns NULL on timeout or if `size` can never fit.
+    void *ChannelReserve(neosmart_channel_t channel, uint32_t size,
+                         uint64_t milliseconds = -1ul);
+    int ChannelCommit(neosmart_channel_t channel);
+
+    // Consumer side: returns the next message in place, or NULL on timeout. Messages remain valid
+    // (and their space unavailable to the producer) until released with ChannelRelease().
+    const void *ChannelRead(neosmart_channel_t channel, uint32_t &size,
+                            uint64_t milliseconds = -1ul);
+    int ChannelRelease(neosmart_channel_t channel);
+} // namespace neosmart
+
+#ifdef PEVENTS_HEADER_ONLY
+#include "pchannel.cpp"
+#endif
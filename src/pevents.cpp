@@ -5,474 +5,2991 @@
  * This code is released under the terms of the MIT License
  */
 
-#ifndef _WIN32
+// In header-only builds this file is included by pevents.h and basic_event.h, but only once
+#ifdef PEVENTS_HEADER_ONLY
+#pragma once
+#endif
 
+#ifdef _WIN32
+#include <Windows.h>
+#include <malloc.h>
+#endif
 #include "pevents.h"
+#include <atomic>
+#include <stdlib.h>
+
+namespace neosmart {
+    PEVENTS_LOCAL void *DefaultAllocate(size_t size, size_t alignment, void *) {
+#ifdef _WIN32
+        return _aligned_malloc(size, alignment);
+#else
+        void *memory = NULL;
+        if (alignment < sizeof(void *)) {
+            alignment = sizeof(void *);
+        }
+        return posix_memalign(&memory, alignment, size) == 0 ? memory : NULL;
+#endif
+    }
+
+    PEVENTS_LOCAL void DefaultDeallocate(void *memory, size_t, size_t, void *) {
+#ifdef _WIN32
+        _aligned_free(memory);
+#else
+        free(memory);
+#endif
+    }
+
+    PEVENTS_LOCAL const neosmart_allocator_t *HeapAllocator() {
+        static const neosmart_allocator_t allocator = {DefaultAllocate, DefaultDeallocate, NULL};
+        return &allocator;
+    }
+
+    PEVENTS_LOCAL std::atomic<const neosmart_allocator_t *> &DefaultAllocatorRef() {
+        static std::atomic<const neosmart_allocator_t *> allocator(HeapAllocator());
+        return allocator;
+    }
+
+    PEVENTS_DECL void SetDefaultAllocator(const neosmart_allocator_t *allocator) {
+        DefaultAllocatorRef().store(allocator != NULL ? allocator : HeapAllocator());
+    }
+
+    PEVENTS_DECL const neosmart_allocator_t *GetDefaultAllocator() {
+        return DefaultAllocatorRef().load(std::memory_order_acquire);
+    }
+
+    PEVENTS_LOCAL void *Allocate(const neosmart_allocator_t *allocator, size_t size,
+                                 size_t alignment) {
+        return allocator->Allocate(size, alignment, allocator->Context);
+    }
+
+    PEVENTS_LOCAL void Deallocate(const neosmart_allocator_t *allocator, void *memory, size_t size,
+                                  size_t alignment) {
+        allocator->Deallocate(memory, size, alignment, allocator->Context);
+    }
+} // namespace neosmart
+
+#ifndef _WIN32
+
+#include "basic_event.h"
+#include <algorithm>
 #include <assert.h>
 #include <errno.h>
+#include <new>
 #include <pthread.h>
-#include <sys/time.h>
-#ifdef WFMO
-#include <algorithm>
-#include <deque>
+#include <string.h>
+#ifdef NUMA
+#ifndef __linux__
+#error NUMA support is only available on Linux
+#endif
+#include <sched.h>
+#include <stddef.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+#ifdef TRACE
+#include <stdio.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+#ifdef REGISTRY
+#include <semaphore.h>
+#include <signal.h>
+#include <stdio.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+#ifdef ATTRIBUTION
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+#ifdef CAPTURE
+#include "pcapture.h"
+#include <stdio.h>
+#endif
+#ifdef NAMED
+#include <fcntl.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
 #endif
 
 namespace neosmart {
-#ifdef WFMO
-    // Each call to WaitForMultipleObjects initializes a neosmart_wfmo_t object which tracks
-    // the progress of the caller's multi-object wait and dispatches responses accordingly.
-    // One neosmart_wfmo_t struct is shared for all events in a single WFMO call
-    struct neosmart_wfmo_t_ {
-        pthread_mutex_t Mutex;
-        pthread_cond_t CVariable;
-        int RefCount;
-        union {
-            int FiredEvent; // WFSO
-            int EventsLeft; // WFMO
-        } Status;
-        bool WaitAll;
-        bool StillWaiting;
-
-        void Destroy() {
-            pthread_mutex_destroy(&Mutex);
-            pthread_cond_destroy(&CVariable);
-        }
+#ifdef NUMA
+    // Event memory is carved out of per-node regions whose pages are bound to that node. Every
+    // region is aligned to its size, so the region (and node) an allocation came from can be
+    // found from its address alone.
+#ifndef PEVENTS_MAX_NUMA_NODES
+#define PEVENTS_MAX_NUMA_NODES 64
+#endif
+#ifndef PEVENTS_MAX_CPUS
+#define PEVENTS_MAX_CPUS 4096
+#endif
+    static_assert(PEVENTS_MAX_NUMA_NODES < 256, "NUMA nodes are cached in a byte per CPU");
+    enum {
+        NUMA_REGION_SIZE = 256 * 1024,
+        NUMA_SIZE_CLASS = 64,
+        NUMA_SIZE_CLASSES = 64, // Small allocations: up to 4 KiB, in 64-byte steps
+        NUMA_MPOL_PREFERRED = 1,
     };
-    typedef neosmart_wfmo_t_ *neosmart_wfmo_t;
 
-    // A neosmart_wfmo_info_t object is registered with each event waited on in a WFMO
-    // This reference to neosmart_wfmo_t_ is how the event knows whom to notify when triggered
-    struct neosmart_wfmo_info_t_ {
-        neosmart_wfmo_t Waiter;
-        int WaitIndex;
+    struct neosmart_numa_region_t_ {
+        size_t MappedSize;
+        int Node;
+        // Set for regions holding a single large allocation
+        bool Dedicated;
+        char *Next;
+        alignas(PEVENTS_CACHE_LINE) char Data[1];
     };
-    typedef neosmart_wfmo_info_t_ *neosmart_wfmo_info_t;
-#endif // WFMO
 
-    // The basic event structure, passed to the caller as an opaque pointer when creating events
-    struct neosmart_event_t_ {
-        pthread_cond_t CVariable;
+    struct neosmart_numa_arena_t_ {
         pthread_mutex_t Mutex;
-        bool AutoReset;
-        bool State;
-#ifdef WFMO
-        std::deque<neosmart_wfmo_info_t_> RegisteredWaits;
-#endif
+        neosmart_numa_region_t_ *Current;
+        void *FreeLists[NUMA_SIZE_CLASSES];
     };
 
-#ifdef WFMO
-    static bool RemoveExpiredWaitHelper(neosmart_wfmo_info_t_ wait) {
-        int result = pthread_mutex_trylock(&wait.Waiter->Mutex);
+    // Called whenever a WFMO waiter is signalled, so the node of each CPU is looked up only once,
+    // and the CPU itself comes from sched_getcpu() (answered by the vDSO or rseq, not a syscall).
+    // Entries hold the node plus one, so that zero means not yet known.
+    PEVENTS_DECL int GetCurrentNumaNode() {
+        static std::atomic<uint8_t> nodes[PEVENTS_MAX_CPUS];
+        int cpu = sched_getcpu();
+        if (cpu >= 0 && cpu < PEVENTS_MAX_CPUS) {
+            uint8_t known = nodes[cpu].load(std::memory_order_relaxed);
+            if (known != 0) {
+                return known - 1;
+            }
+        }
 
-        if (result == EBUSY) {
-            return false;
+        unsigned current = 0, node = 0;
+        if (syscall(SYS_getcpu, &current, &node, NULL) != 0) {
+            return 0;
         }
+        if (current < PEVENTS_MAX_CPUS && node < PEVENTS_MAX_NUMA_NODES) {
+            nodes[current].store((uint8_t)(node + 1), std::memory_order_relaxed);
+        }
+        return (int)node;
+    }
 
-        assert(result == 0);
+    PEVENTS_LOCAL neosmart_numa_arena_t_ *NumaArena(int node) {
+        static neosmart_numa_arena_t_ *arenas = []() {
+            static neosmart_numa_arena_t_ arenas[PEVENTS_MAX_NUMA_NODES];
+            for (int i = 0; i < PEVENTS_MAX_NUMA_NODES; ++i) {
+                pthread_mutex_init(&arenas[i].Mutex, 0);
+            }
+            return arenas;
+        }();
+        return &arenas[node];
+    }
 
-        if (wait.Waiter->StillWaiting == false) {
-            --wait.Waiter->RefCount;
-            assert(wait.Waiter->RefCount >= 0);
-            bool destroy = wait.Waiter->RefCount == 0;
-            result = pthread_mutex_unlock(&wait.Waiter->Mutex);
-            assert(result == 0);
-            if (destroy) {
-                wait.Waiter->Destroy();
-                delete wait.Waiter;
+    PEVENTS_LOCAL neosmart_numa_region_t_ *MapNumaRegion(int node, size_t size) {
+        // Over-map so that a size-aligned region can be trimmed out of the mapping
+        size_t alignment = NUMA_REGION_SIZE;
+        size = (size + alignment - 1) & ~(alignment - 1);
+        char *mapping = static_cast<char *>(mmap(NULL, size + alignment, PROT_READ | PROT_WRITE,
+                                                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+        if (mapping == MAP_FAILED) {
+            return NULL;
+        }
+        char *region =
+            (char *)(((uintptr_t)mapping + alignment - 1) & ~(uintptr_t)(alignment - 1));
+        if (region != mapping) {
+            munmap(mapping, region - mapping);
+        }
+        munmap(region + size, alignment - (region - mapping));
+
+        // Only a preference: if the node is full (or doesn't exist), fall back to any memory
+        unsigned long nodemask[PEVENTS_MAX_NUMA_NODES / (8 * sizeof(unsigned long)) + 1] = {0};
+        nodemask[node / (8 * sizeof(unsigned long))] = 1ul << (node % (8 * sizeof(unsigned long)));
+        syscall(SYS_mbind, region, size, NUMA_MPOL_PREFERRED, nodemask,
+                PEVENTS_MAX_NUMA_NODES + 1, 0);
+
+        neosmart_numa_region_t_ *result = reinterpret_cast<neosmart_numa_region_t_ *>(region);
+        result->MappedSize = size;
+        result->Node = node;
+        result->Next = result->Data;
+        return result;
+    }
+
+    PEVENTS_LOCAL void *NumaAllocate(size_t size, size_t alignment, void *context) {
+        int node = (int)(intptr_t)context;
+        if (node == NUMA_LOCAL_NODE) {
+            node = GetCurrentNumaNode();
+        }
+        if (node < 0 || node >= PEVENTS_MAX_NUMA_NODES || alignment > PEVENTS_CACHE_LINE) {
+            return NULL;
+        }
+
+        uint32_t sizeClass = (uint32_t)((size + NUMA_SIZE_CLASS - 1) / NUMA_SIZE_CLASS);
+        if (sizeClass > NUMA_SIZE_CLASSES) {
+            neosmart_numa_region_t_ *region =
+                MapNumaRegion(node, offsetof(neosmart_numa_region_t_, Data) + size);
+            if (region == NULL) {
+                return NULL;
             }
+            region->Dedicated = true;
+            return region->Data;
+        }
 
-            return true;
+        neosmart_numa_arena_t_ *arena = NumaArena(node);
+        int result = pthread_mutex_lock(&arena->Mutex);
+        assert(result == 0);
+
+        void *memory = arena->FreeLists[sizeClass - 1];
+        if (memory != NULL) {
+            arena->FreeLists[sizeClass - 1] = *static_cast<void **>(memory);
+        } else {
+            size_t bytes = sizeClass * NUMA_SIZE_CLASS;
+            neosmart_numa_region_t_ *region = arena->Current;
+            if (region == NULL ||
+                (size_t)((char *)region + NUMA_REGION_SIZE - region->Next) < bytes) {
+                // Whatever is left at the end of the old region is abandoned
+                region = MapNumaRegion(node, NUMA_REGION_SIZE);
+                if (region != NULL) {
+                    region->Dedicated = false;
+                    arena->Current = region;
+                }
+            }
+            if (region != NULL) {
+                memory = region->Next;
+                region->Next += bytes;
+            }
         }
 
-        result = pthread_mutex_unlock(&wait.Waiter->Mutex);
+        result = pthread_mutex_unlock(&arena->Mutex);
         assert(result == 0);
 
-        return false;
+        return memory;
     }
-#endif // WFMO
 
-    neosmart_event_t CreateEvent(bool manualReset, bool initialState) {
-        neosmart_event_t event = new neosmart_event_t_;
+    PEVENTS_LOCAL void NumaDeallocate(void *memory, size_t size, size_t, void *) {
+        neosmart_numa_region_t_ *region = reinterpret_cast<neosmart_numa_region_t_ *>(
+            (uintptr_t)memory & ~(uintptr_t)(NUMA_REGION_SIZE - 1));
+        if (region->Dedicated) {
+            munmap(region, region->MappedSize);
+            return;
+        }
 
-        int result = pthread_cond_init(&event->CVariable, 0);
+        // Memory goes back to the node it was allocated on, not the node of the freeing thread
+        uint32_t sizeClass = (uint32_t)((size + NUMA_SIZE_CLASS - 1) / NUMA_SIZE_CLASS);
+        neosmart_numa_arena_t_ *arena = NumaArena(region->Node);
+        int result = pthread_mutex_lock(&arena->Mutex);
         assert(result == 0);
-
-        result = pthread_mutex_init(&event->Mutex, 0);
+        *static_cast<void **>(memory) = arena->FreeLists[sizeClass - 1];
+        arena->FreeLists[sizeClass - 1] = memory;
+        result = pthread_mutex_unlock(&arena->Mutex);
         assert(result == 0);
+    }
 
-        event->State = false;
-        event->AutoReset = !manualReset;
-
-        if (initialState) {
-            result = SetEvent(event);
-            assert(result == 0);
+    PEVENTS_DECL const neosmart_allocator_t *GetNumaAllocator(int node) {
+        // One allocator per node, plus one that follows the allocating thread
+        static neosmart_allocator_t *allocators = []() {
+            static neosmart_allocator_t allocators[PEVENTS_MAX_NUMA_NODES + 1];
+            for (int i = 0; i <= PEVENTS_MAX_NUMA_NODES; ++i) {
+                allocators[i].Allocate = NumaAllocate;
+                allocators[i].Deallocate = NumaDeallocate;
+                allocators[i].Context = (void *)(intptr_t)(i - 1);
+            }
+            return allocators;
+        }();
+        if (node < NUMA_LOCAL_NODE || node >= PEVENTS_MAX_NUMA_NODES) {
+            return NULL;
         }
+        return &allocators[node + 1];
+    }
+#endif // NUMA
 
-        return event;
+#ifdef STATS
+#ifndef PEVENTS_STATS_STRIPES
+#define PEVENTS_STATS_STRIPES 16
+#endif
+    PEVENTS_LOCAL detail::event_counters_stripe *GlobalCounterStripes() {
+        static detail::event_counters_stripe stripes[PEVENTS_STATS_STRIPES];
+        return stripes;
     }
 
-    static int UnlockedWaitForEvent(neosmart_event_t event, uint64_t milliseconds) {
-        int result = 0;
-        if (!event->State) {
-            // Zero-timeout event state check optimization
-            if (milliseconds == 0) {
-                return WAIT_TIMEOUT;
-            }
+    PEVENTS_DECL detail::event_counters &detail::AssignGlobalCounters() {
+        static std::atomic<uint32_t> next(0);
+        uint32_t stripe = next.fetch_add(1, std::memory_order_relaxed) % PEVENTS_STATS_STRIPES;
+        return GlobalCounterStripes()[stripe].Counters;
+    }
 
-            timespec ts;
-            if (milliseconds != -1ul) {
-                timeval tv;
-                gettimeofday(&tv, NULL);
+    PEVENTS_DECL void detail::event_counters::Snapshot(neosmart_event_stats_t &stats) const {
+        stats.Sets = Sets.load(std::memory_order_relaxed);
+        stats.RedundantSets = RedundantSets.load(std::memory_order_relaxed);
+        stats.Resets = Resets.load(std::memory_order_relaxed);
+        stats.Waits = Waits.load(std::memory_order_relaxed);
+        stats.Timeouts = Timeouts.load(std::memory_order_relaxed);
+        stats.SpuriousWakeups = SpuriousWakeups.load(std::memory_order_relaxed);
+        stats.WfmoRegistrations = WfmoRegistrations.load(std::memory_order_relaxed);
+        stats.ExpiredWaitsRemoved = ExpiredWaitsRemoved.load(std::memory_order_relaxed);
+        stats.PeakWaiters = PeakWaiters.load(std::memory_order_relaxed);
+    }
 
-                uint64_t nanoseconds = ((uint64_t)tv.tv_sec) * 1000 * 1000 * 1000 +
-                                       milliseconds * 1000 * 1000 + ((uint64_t)tv.tv_usec) * 1000;
+    PEVENTS_DECL void GetGlobalEventStats(neosmart_event_stats_t *stats) {
+        memset(stats, 0, sizeof(*stats));
+        for (int i = 0; i < PEVENTS_STATS_STRIPES; ++i) {
+            neosmart_event_stats_t stripe;
+            GlobalCounterStripes()[i].Counters.Snapshot(stripe);
+            stats->Sets += stripe.Sets;
+            stats->RedundantSets += stripe.RedundantSets;
+            stats->Resets += stripe.Resets;
+            stats->Waits += stripe.Waits;
+            stats->Timeouts += stripe.Timeouts;
+            stats->SpuriousWakeups += stripe.SpuriousWakeups;
+            stats->WfmoRegistrations += stripe.WfmoRegistrations;
+            stats->ExpiredWaitsRemoved += stripe.ExpiredWaitsRemoved;
+            stats->PeakWaiters = std::max(stats->PeakWaiters, stripe.PeakWaiters);
+        }
+    }
+#endif // STATS
+
+#ifdef LATENCY
+    struct detail::latency_histogram {
+        const neosmart_allocator_t *Allocator;
+        std::atomic<uint64_t> Count;
+        std::atomic<uint64_t> Sum;
+        std::atomic<uint64_t> Min;
+        std::atomic<uint64_t> Max;
+        std::atomic<uint64_t> Buckets[LATENCY_BUCKETS];
+    };
 
-                ts.tv_sec = nanoseconds / 1000 / 1000 / 1000;
-                ts.tv_nsec = (long) (nanoseconds - ((uint64_t)ts.tv_sec) * 1000 * 1000 * 1000);
-            }
+    PEVENTS_LOCAL int LatencyBucket(uint64_t latency) {
+        if (latency < 8) {
+            return (int)latency;
+        }
+        int log2 = 63 - __builtin_clzll(latency);
+        int bucket = (log2 - 2) * 8 + (int)((latency >> (log2 - 3)) & 7);
+        return std::min(bucket, (int)LATENCY_BUCKETS - 1);
+    }
 
-            do {
-                // Regardless of whether it's an auto-reset or manual-reset event:
-                // wait to obtain the event, then lock anyone else out
-                if (milliseconds != -1ul) {
-                    result = pthread_cond_timedwait(&event->CVariable, &event->Mutex, &ts);
-                } else {
-                    result = pthread_cond_wait(&event->CVariable, &event->Mutex);
-                }
-            } while (result == 0 && !event->State);
+    PEVENTS_DECL uint64_t LatencyBucketBase(int bucket) {
+        if (bucket < 8) {
+            return bucket;
+        }
+        int log2 = bucket / 8 + 2;
+        return (uint64_t)(8 + bucket % 8) << (log2 - 3);
+    }
 
-            if (result == 0 && event->AutoReset) {
-                // We've only accquired the event if the wait succeeded
-                event->State = false;
+    PEVENTS_DECL void detail::RecordLatency(std::atomic<latency_histogram *> &histogram,
+                                            const neosmart_allocator_t *allocator,
+                                            uint64_t latency) {
+        latency_histogram *latencies = histogram.load(std::memory_order_acquire);
+        if (latencies == NULL) {
+            if (allocator == NULL) {
+                allocator = GetDefaultAllocator();
+            }
+            latencies = static_cast<latency_histogram *>(
+                Allocate(allocator, sizeof(latency_histogram), alignof(latency_histogram)));
+            if (latencies == NULL) {
+                // The sample is dropped
+                return;
+            }
+            memset(static_cast<void *>(latencies), 0, sizeof(latency_histogram));
+            latencies->Allocator = allocator;
+            latencies->Min.store(UINT64_MAX, std::memory_order_relaxed);
+
+            latency_histogram *expected = NULL;
+            if (!histogram.compare_exchange_strong(expected, latencies,
+                                                   std::memory_order_acq_rel)) {
+                // Another waiter got there first
+                Deallocate(allocator, latencies, sizeof(latency_histogram),
+                           alignof(latency_histogram));
+                latencies = expected;
             }
-        } else if (event->AutoReset) {
-            // It's an auto-reset event that's currently available;
-            // we need to stop anyone else from using it
-            result = 0;
-            event->State = false;
         }
-        // Else we're trying to obtain a manual reset event with a signaled state;
-        // don't do anything
 
-        return result;
+        latencies->Count.fetch_add(1, std::memory_order_relaxed);
+        latencies->Sum.fetch_add(latency, std::memory_order_relaxed);
+        latencies->Buckets[LatencyBucket(latency)].fetch_add(1, std::memory_order_relaxed);
+        uint64_t min = latencies->Min.load(std::memory_order_relaxed);
+        while (latency < min && !latencies->Min.compare_exchange_weak(
+                                    min, latency, std::memory_order_relaxed)) {
+        }
+        uint64_t max = latencies->Max.load(std::memory_order_relaxed);
+        while (latency > max && !latencies->Max.compare_exchange_weak(
+                                    max, latency, std::memory_order_relaxed)) {
+        }
+    }
+
+    PEVENTS_DECL void detail::FreeLatencies(latency_histogram *histogram) {
+        Deallocate(histogram->Allocator, histogram, sizeof(latency_histogram),
+                   alignof(latency_histogram));
+    }
+
+    PEVENTS_DECL uint64_t GetLastWakeLatency() {
+        return detail::LastWake().Valid ? detail::LastWake().Latency : 0;
+    }
+
+    PEVENTS_DECL int GetEventLatencies(neosmart_event_t event, neosmart_latency_stats_t *stats) {
+        memset(stats, 0, sizeof(*stats));
+        detail::latency_histogram *latencies = event->Latencies.load(std::memory_order_acquire);
+        if (latencies == NULL) {
+            return 0;
+        }
+
+        stats->Count = latencies->Count.load(std::memory_order_relaxed);
+        stats->Sum = latencies->Sum.load(std::memory_order_relaxed);
+        stats->Min = latencies->Min.load(std::memory_order_relaxed);
+        stats->Max = latencies->Max.load(std::memory_order_relaxed);
+        for (int i = 0; i < LATENCY_BUCKETS; ++i) {
+            stats->Buckets[i] = latencies->Buckets[i].load(std::memory_order_relaxed);
+        }
+        return 0;
     }
 
-    int WaitForEvent(neosmart_event_t event, uint64_t milliseconds) {
-        int tempResult;
-        if (milliseconds == 0) {
-            tempResult = pthread_mutex_trylock(&event->Mutex);
-            if (tempResult == EBUSY) {
-                return WAIT_TIMEOUT;
+    PEVENTS_DECL uint64_t LatencyPercentile(const neosmart_latency_stats_t *stats,
+                                            double percentile) {
+        uint64_t total = 0;
+        for (int i = 0; i < LATENCY_BUCKETS; ++i) {
+            total += stats->Buckets[i];
+        }
+        // The rank of the sample we're after, counting from 1
+        uint64_t rank = (uint64_t)(percentile / 100.0 * total + 0.5);
+        rank = std::max<uint64_t>(rank, 1);
+
+        uint64_t seen = 0;
+        for (int i = 0; i < LATENCY_BUCKETS; ++i) {
+            seen += stats->Buckets[i];
+            if (seen >= rank) {
+                // Report the top of the bucket, but no more than anything actually seen
+                uint64_t top = i + 1 < LATENCY_BUCKETS ? LatencyBucketBase(i + 1) - 1 : stats->Max;
+                return std::min(top, stats->Max);
             }
-        } else {
-            tempResult = pthread_mutex_lock(&event->Mutex);
         }
+        return stats->Max;
+    }
+#endif // LATENCY
 
-        assert(tempResult == 0);
+#ifdef TRACE
+#ifndef PEVENTS_TRACE_RECORDS
+#define PEVENTS_TRACE_RECORDS 4096
+#endif
+    enum {
+        TRACE_SET,
+        TRACE_RESET,
+        TRACE_WAIT,
+        TRACE_WFMO,
+    };
 
-        int result = UnlockedWaitForEvent(event, milliseconds);
+    // One traced call, from Begin to End in TraceClock() ticks
+    struct neosmart_trace_record_t_ {
+        uint64_t Begin;
+        uint64_t End;
+        const void *Event;
+        // For sets, the flow started; for waits, the flow of the set that woke them (if any)
+        uint64_t Flow;
+        int Result;
+        int Type;
+    };
 
-        tempResult = pthread_mutex_unlock(&event->Mutex);
-        assert(tempResult == 0);
+    // Every thread records into a ring of its own, which is only ever written by that thread and
+    // so needs no locking. Rings are kept (and can still be dumped) after their thread exits, and
+    // are taken from the default allocator of the time but never given back to it.
+    struct neosmart_trace_ring_t_ {
+        neosmart_trace_ring_t_ *Next;
+        uint64_t ThreadId;
+        // The number of records ever written; the ring holds the last PEVENTS_TRACE_RECORDS
+        std::atomic<uint64_t> Head;
+        uint64_t NextFlow;
+        neosmart_trace_record_t_ Records[PEVENTS_TRACE_RECORDS];
+    };
 
-        return result;
+    struct neosmart_trace_state_t_ {
+        pthread_mutex_t Mutex;
+        std::atomic<neosmart_trace_ring_t_ *> Rings;
+        std::atomic<uint32_t> RingCount;
+        // Ties TraceClock() ticks to the monotonic clock
+        uint64_t BaseTicks;
+        uint64_t BaseNanoseconds;
+    };
+
+    PEVENTS_LOCAL uint64_t MonotonicNanoseconds() {
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t)ts.tv_sec * 1000 * 1000 * 1000 + ts.tv_nsec;
     }
 
-#ifdef WFMO
-    int WaitForMultipleEvents(neosmart_event_t *events, int count, bool waitAll,
-                              uint64_t milliseconds) {
-        int unused;
-        return WaitForMultipleEvents(events, count, waitAll, milliseconds, unused);
+    // The TSC where there is one (assumed to be invariant, as on any recent x86 processor), and
+    // the monotonic clock elsewhere
+    PEVENTS_LOCAL uint64_t TraceClock() {
+#if defined(__x86_64__) || defined(__i386__)
+        return __builtin_ia32_rdtsc();
+#else
+        return MonotonicNanoseconds();
+#endif
     }
 
-    int WaitForMultipleEvents(neosmart_event_t *events, int count, bool waitAll,
-                              uint64_t milliseconds, int &waitIndex) {
-        neosmart_wfmo_t wfmo = new neosmart_wfmo_t_;
+    PEVENTS_LOCAL neosmart_trace_state_t_ &TraceState() {
+        static neosmart_trace_state_t_ state = {PTHREAD_MUTEX_INITIALIZER, {NULL}, {0},
+                                                TraceClock(), MonotonicNanoseconds()};
+        return state;
+    }
 
-        int result = 0;
-        int tempResult = pthread_mutex_init(&wfmo->Mutex, 0);
-        assert(tempResult == 0);
+    PEVENTS_LOCAL neosmart_trace_ring_t_ *AllocateTraceRing() {
+        neosmart_trace_state_t_ &state = TraceState();
+        neosmart_trace_ring_t_ *ring = static_cast<neosmart_trace_ring_t_ *>(
+            Allocate(GetDefaultAllocator(), sizeof(neosmart_trace_ring_t_), PEVENTS_CACHE_LINE));
+        if (ring == NULL) {
+            return NULL;
+        }
+        memset(static_cast<void *>(ring), 0, sizeof(neosmart_trace_ring_t_));
+#ifdef __linux__
+        ring->ThreadId = (uint64_t)syscall(SYS_gettid);
+#else
+        ring->ThreadId = state.RingCount.load(std::memory_order_relaxed) + 1;
+#endif
 
-        tempResult = pthread_cond_init(&wfmo->CVariable, 0);
-        assert(tempResult == 0);
+        int result = pthread_mutex_lock(&state.Mutex);
+        assert(result == 0);
+        // Flows are numbered per thread, in a range of their own
+        ring->NextFlow = ((uint64_t)state.RingCount.fetch_add(1) + 1) << 32;
+        ring->Next = state.Rings.load(std::memory_order_relaxed);
+        state.Rings.store(ring, std::memory_order_release);
+        result = pthread_mutex_unlock(&state.Mutex);
+        assert(result == 0);
 
-        neosmart_wfmo_info_t_ waitInfo;
-        waitInfo.Waiter = wfmo;
-        waitInfo.WaitIndex = -1;
+        return ring;
+    }
 
-        wfmo->WaitAll = waitAll;
-        wfmo->StillWaiting = true;
-        wfmo->RefCount = 1;
+    PEVENTS_LOCAL neosmart_trace_ring_t_ *TraceRing() {
+        static thread_local neosmart_trace_ring_t_ *ring = AllocateTraceRing();
+        return ring;
+    }
 
-        if (waitAll) {
-            wfmo->Status.EventsLeft = count;
+    PEVENTS_LOCAL void Trace(int type, const void *event, uint64_t begin, uint64_t flow,
+                             int result) {
+        neosmart_trace_ring_t_ *ring = TraceRing();
+        if (ring == NULL) {
+            return;
+        }
+        uint64_t head = ring->Head.load(std::memory_order_relaxed);
+        neosmart_trace_record_t_ &record = ring->Records[head % PEVENTS_TRACE_RECORDS];
+        record.Begin = begin;
+        record.End = TraceClock();
+        record.Event = event;
+        record.Flow = flow;
+        record.Result = result;
+        record.Type = type;
+        ring->Head.store(head + 1, std::memory_order_release);
+    }
+
+    // Starts a flow for the SetEvent() about to be made by the calling thread
+    PEVENTS_LOCAL uint64_t BeginTraceSet() {
+        neosmart_trace_ring_t_ *ring = TraceRing();
+        uint64_t flow = ring != NULL ? ++ring->NextFlow : 0;
+        detail::TraceFlow() = flow;
+        return flow;
+    }
+
+    PEVENTS_LOCAL uint64_t WakeFlow() {
+        return detail::LastWake().Valid ? detail::LastWake().Flow : 0;
+    }
+
+    // Converts TraceClock() ticks to microseconds on the monotonic clock, so that traces taken
+    // by different processes line up
+    PEVENTS_LOCAL double TraceMicroseconds(uint64_t ticks, double ticksPerMicrosecond) {
+        neosmart_trace_state_t_ &state = TraceState();
+        return state.BaseNanoseconds / 1000.0 +
+               (double)(int64_t)(ticks - state.BaseTicks) / ticksPerMicrosecond;
+    }
+
+    PEVENTS_LOCAL void WriteTraceRecord(FILE *file, const neosmart_trace_record_t_ &record,
+                                        uint64_t threadId, int pid, double ticksPerMicrosecond,
+                                        bool &first) {
+        static const char *const names[] = {"SetEvent", "ResetEvent", "WaitForEvent",
+                                            "WaitForMultipleEvents"};
+        double begin = TraceMicroseconds(record.Begin, ticksPerMicrosecond);
+        double end = TraceMicroseconds(record.End, ticksPerMicrosecond);
+
+        fprintf(file,
+                "%s\n{\"name\":\"%s\",\"cat\":\"pevents\",\"ph\":\"X\",\"pid\":%d,"
+                "\"tid\":%llu,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"event\":\"%p\"",
+                first ? "" : ",", names[record.Type], pid, (unsigned long long)threadId, begin,
+                end - begin, record.Event);
+        if (record.Type == TRACE_WAIT || record.Type == TRACE_WFMO) {
+            fprintf(file, ",\"result\":%d", record.Result);
+        }
+        fprintf(file, "}}");
+        first = false;
+
+        if (record.Flow == 0) {
+            return;
+        }
+        // Flow arrows run from the set to the end of the wait it woke
+        if (record.Type == TRACE_SET) {
+            fprintf(file,
+                    ",\n{\"name\":\"wake\",\"cat\":\"pevents\",\"ph\":\"s\",\"id\":%llu,"
+                    "\"pid\":%d,\"tid\":%llu,\"ts\":%.3f}",
+                    (unsigned long long)record.Flow, pid, (unsigned long long)threadId, begin);
         } else {
-            wfmo->Status.FiredEvent = -1;
+            fprintf(file,
+                    ",\n{\"name\":\"wake\",\"cat\":\"pevents\",\"ph\":\"f\",\"bp\":\"e\","
+                    "\"id\":%llu,\"pid\":%d,\"tid\":%llu,\"ts\":%.3f}",
+                    (unsigned long long)record.Flow, pid, (unsigned long long)threadId, end);
         }
+    }
 
-        tempResult = pthread_mutex_lock(&wfmo->Mutex);
-        assert(tempResult == 0);
+    PEVENTS_DECL int WriteEventTrace(const char *path) {
+        FILE *file = fopen(path, "w");
+        if (file == NULL) {
+            return errno;
+        }
 
-        bool done = false;
-        waitIndex = -1;
+        neosmart_trace_state_t_ &state = TraceState();
+        uint64_t ticks = TraceClock();
+        uint64_t nanoseconds = MonotonicNanoseconds();
+        double ticksPerMicrosecond = 1000.0;
+        if (nanoseconds > state.BaseNanoseconds + 1000) {
+            ticksPerMicrosecond = (double)(ticks - state.BaseTicks) /
+                                  ((nanoseconds - state.BaseNanoseconds) / 1000.0);
+        }
 
-        for (int i = 0; i < count; ++i) {
-            waitInfo.WaitIndex = i;
-
-            // Must not release lock until RegisteredWait is potentially added
-            tempResult = pthread_mutex_lock(&events[i]->Mutex);
-            assert(tempResult == 0);
-
-            // Before adding this wait to the list of registered waits, let's clean up old, expired
-            // waits while we have the event lock anyway
-            events[i]->RegisteredWaits.erase(std::remove_if(events[i]->RegisteredWaits.begin(),
-                                                            events[i]->RegisteredWaits.end(),
-                                                            RemoveExpiredWaitHelper),
-                                             events[i]->RegisteredWaits.end());
-
-            if (UnlockedWaitForEvent(events[i], 0) == 0) {
-                tempResult = pthread_mutex_unlock(&events[i]->Mutex);
-                assert(tempResult == 0);
-
-                if (waitAll) {
-                    --wfmo->Status.EventsLeft;
-                    assert(wfmo->Status.EventsLeft >= 0);
-                } else {
-                    wfmo->Status.FiredEvent = i;
-                    waitIndex = i;
-                    done = true;
-                    break;
+        int pid = (int)getpid();
+        bool first = true;
+        fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+        for (neosmart_trace_ring_t_ *ring = state.Rings.load(std::memory_order_acquire);
+             ring != NULL; ring = ring->Next) {
+            uint64_t head = ring->Head.load(std::memory_order_acquire);
+            uint64_t tail = head > PEVENTS_TRACE_RECORDS ? head - PEVENTS_TRACE_RECORDS : 0;
+            for (uint64_t i = tail; i < head; ++i) {
+                neosmart_trace_record_t_ record = ring->Records[i % PEVENTS_TRACE_RECORDS];
+                // Skip records the thread has since written over (or is writing over)
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (i + PEVENTS_TRACE_RECORDS <= ring->Head.load(std::memory_order_relaxed)) {
+                    continue;
                 }
-            } else {
-                events[i]->RegisteredWaits.push_back(waitInfo);
-                ++wfmo->RefCount;
-
-                tempResult = pthread_mutex_unlock(&events[i]->Mutex);
-                assert(tempResult == 0);
+                WriteTraceRecord(file, record, ring->ThreadId, pid, ticksPerMicrosecond, first);
             }
         }
+        fprintf(file, "\n]}\n");
 
-        // We set the `done` flag above in case of WaitAny and at least one event was set.
-        // But we need to check again here if we were doing a WaitAll or else we'll incorrectly
-        // return WAIT_TIMEOUT.
-        if (waitAll && wfmo->Status.EventsLeft == 0) {
-            done = true;
-        }
+        return fclose(file) == 0 ? 0 : errno;
+    }
+#endif // TRACE
 
-        timespec ts;
-        if (!done) {
-            if (milliseconds == 0) {
-                result = WAIT_TIMEOUT;
-                done = true;
-            } else if (milliseconds != -1ul) {
-                timeval tv;
-                gettimeofday(&tv, NULL);
+#ifdef CONTENTION
+#ifndef PEVENTS_CONTENTION_SLOTS
+#define PEVENTS_CONTENTION_SLOTS 1024
+#endif
+    struct neosmart_lock_profile_t_ {
+        std::atomic<uint64_t> Acquisitions;
+        std::atomic<uint64_t> HoldNanoseconds;
+        std::atomic<uint64_t> Contended;
+        std::atomic<uint64_t> WaitNanoseconds;
+        std::atomic<uint64_t> MaxWaitNanoseconds;
+    };
+
+    struct neosmart_contention_entry_t_ {
+        std::atomic<const void *> Event;
+        std::atomic<bool> Destroyed;
+        neosmart_lock_profile_t_ Ops[LOCK_OPS];
+    };
 
-                uint64_t nanoseconds = ((uint64_t)tv.tv_sec) * 1000 * 1000 * 1000 +
-                                       milliseconds * 1000 * 1000 + ((uint64_t)tv.tv_usec) * 1000;
+    struct neosmart_contention_table_t_ {
+        // Slots handed out so far (which may run past the end of Entries once it's full)
+        std::atomic<uint32_t> Count;
+        neosmart_contention_entry_t_ Entries[PEVENTS_CONTENTION_SLOTS];
+        // WFMO waiters come and go too quickly to be profiled one by one
+        neosmart_lock_profile_t_ Waiters[LOCK_OPS];
+    };
+
+    PEVENTS_LOCAL neosmart_contention_table_t_ &ContentionTable() {
+        static neosmart_contention_table_t_ table;
+        return table;
+    }
+
+    PEVENTS_LOCAL void AddWait(neosmart_lock_profile_t_ &profile, uint64_t wait) {
+        profile.Contended.fetch_add(1, std::memory_order_relaxed);
+        profile.WaitNanoseconds.fetch_add(wait, std::memory_order_relaxed);
+        uint64_t max = profile.MaxWaitNanoseconds.load(std::memory_order_relaxed);
+        while (wait > max && !profile.MaxWaitNanoseconds.compare_exchange_weak(
+                                 max, wait, std::memory_order_relaxed)) {
+        }
+    }
+
+    PEVENTS_LOCAL void AddHold(neosmart_lock_profile_t_ &profile, uint64_t hold) {
+        profile.Acquisitions.fetch_add(1, std::memory_order_relaxed);
+        profile.HoldNanoseconds.fetch_add(hold, std::memory_order_relaxed);
+    }
 
-                ts.tv_sec = nanoseconds / 1000 / 1000 / 1000;
-                ts.tv_nsec = (long) (nanoseconds - ((uint64_t)ts.tv_sec) * 1000 * 1000 * 1000);
+    PEVENTS_DECL void detail::RecordContention(std::atomic<int> &slot, const void *event, int op,
+                                               uint64_t wait) {
+        neosmart_contention_table_t_ &table = ContentionTable();
+        int index = slot.load(std::memory_order_relaxed);
+        if (index == PROFILE_NONE) {
+            // The event's mutex is held, so no one else can be claiming a slot for it
+            uint32_t claimed = table.Count.fetch_add(1, std::memory_order_relaxed);
+            if (claimed >= PEVENTS_CONTENTION_SLOTS) {
+                slot.store(PROFILE_DISABLED, std::memory_order_relaxed);
+                return;
             }
+            table.Entries[claimed].Event.store(event, std::memory_order_release);
+            index = (int)claimed;
+            slot.store(index, std::memory_order_relaxed);
         }
+        if (index >= 0) {
+            AddWait(table.Entries[index].Ops[op], wait);
+        }
+    }
 
-        while (!done) {
-            // One (or more) of the events we're monitoring has been triggered?
+    PEVENTS_DECL void detail::RecordHold(int slot, int op, uint64_t hold) {
+        AddHold(ContentionTable().Entries[slot].Ops[op], hold);
+    }
 
-            // If we're waiting for all events, assume we're done and check if there's an event that
-            // hasn't fired But if we're waiting for just one event, assume we're not done until we
-            // find a fired event
-            done = (waitAll && wfmo->Status.EventsLeft == 0) ||
-                   (!waitAll && wfmo->Status.FiredEvent != -1);
+    PEVENTS_DECL void detail::RetireContention(int slot) {
+        ContentionTable().Entries[slot].Destroyed.store(true, std::memory_order_relaxed);
+    }
 
-            if (!done) {
-                if (milliseconds != -1ul) {
-                    result = pthread_cond_timedwait(&wfmo->CVariable, &wfmo->Mutex, &ts);
-                } else {
-                    result = pthread_cond_wait(&wfmo->CVariable, &wfmo->Mutex);
-                }
+    PEVENTS_LOCAL void SnapshotLockProfile(const neosmart_lock_profile_t_ &profile,
+                                           neosmart_lock_stats_t &stats) {
+        stats.Acquisitions = profile.Acquisitions.load(std::memory_order_relaxed);
+        stats.HoldNanoseconds = profile.HoldNanoseconds.load(std::memory_order_relaxed);
+        stats.Contended = profile.Contended.load(std::memory_order_relaxed);
+        stats.WaitNanoseconds = profile.WaitNanoseconds.load(std::memory_order_relaxed);
+        stats.MaxWaitNanoseconds = profile.MaxWaitNanoseconds.load(std::memory_order_relaxed);
+    }
 
-                if (result != 0) {
-                    break;
+    // Returns false if the slot hasn't been filled in yet
+    PEVENTS_LOCAL bool SnapshotContention(int slot, neosmart_event_contention_t &contention) {
+        const neosmart_contention_entry_t_ &entry = ContentionTable().Entries[slot];
+        contention.Event = entry.Event.load(std::memory_order_acquire);
+        if (contention.Event == NULL) {
+            return false;
+        }
+        contention.Destroyed = entry.Destroyed.load(std::memory_order_relaxed);
+        contention.WaitNanoseconds = 0;
+        for (int op = 0; op < LOCK_OPS; ++op) {
+            SnapshotLockProfile(entry.Ops[op], contention.Ops[op]);
+            contention.WaitNanoseconds += contention.Ops[op].WaitNanoseconds;
+        }
+        return true;
+    }
+
+    PEVENTS_DECL int GetContendedEvents(neosmart_event_contention_t *events, int count) {
+        uint32_t slots = std::min<uint32_t>(ContentionTable().Count.load(std::memory_order_acquire),
+                                            PEVENTS_CONTENTION_SLOTS);
+        int filled = 0;
+        for (uint32_t slot = 0; slot < slots; ++slot) {
+            neosmart_event_contention_t contention;
+            if (!SnapshotContention(slot, contention)) {
+                continue;
+            }
+            // Insertion into the (sorted) results, dropping whatever falls off the end
+            int i = filled < count ? filled++ : count;
+            for (; i > 0 && events[i - 1].WaitNanoseconds < contention.WaitNanoseconds; --i) {
+                if (i < count) {
+                    events[i] = events[i - 1];
                 }
             }
+            if (i < count) {
+                events[i] = contention;
+            }
         }
+        return filled;
+    }
 
-        waitIndex = wfmo->Status.FiredEvent;
-        wfmo->StillWaiting = false;
+    PEVENTS_DECL void GetWaiterContention(neosmart_lock_stats_t *stats) {
+        for (int op = 0; op < LOCK_OPS; ++op) {
+            SnapshotLockProfile(ContentionTable().Waiters[op], stats[op]);
+        }
+    }
 
-        --wfmo->RefCount;
-        assert(wfmo->RefCount >= 0);
-        bool destroy = wfmo->RefCount == 0;
-        tempResult = pthread_mutex_unlock(&wfmo->Mutex);
-        assert(tempResult == 0);
-        if (destroy) {
-            wfmo->Destroy();
-            delete wfmo;
+    // Takes a WFMO waiter's mutex on behalf of `op`
+    PEVENTS_LOCAL void LockWaiter(neosmart_wfmo_t wfmo, int op) {
+        if (detail::Recover(&wfmo->Mutex, pthread_mutex_trylock(&wfmo->Mutex)) != 0) {
+            uint64_t start = detail::Now();
+            int result = detail::Recover(&wfmo->Mutex, pthread_mutex_lock(&wfmo->Mutex));
+            assert(result == 0);
+            AddWait(ContentionTable().Waiters[op], detail::Now() - start);
         }
+    }
+#endif // CONTENTION
 
-        return result;
+#ifdef REGISTRY
+    // Live events, most recently registered first. Events join on creation and leave on
+    // destruction, so nothing here is touched by setting, resetting or waiting on them.
+    struct neosmart_registry_t_ {
+        pthread_mutex_t Mutex;
+        neosmart_event_t Head;
+        int Count;
+    };
+
+    PEVENTS_LOCAL neosmart_registry_t_ &Registry() {
+        static neosmart_registry_t_ registry = {PTHREAD_MUTEX_INITIALIZER, NULL, 0};
+        return registry;
+    }
+
+    // Called with the registry mutex held
+    PEVENTS_LOCAL void LinkEvent(neosmart_registry_t_ &registry, neosmart_event_t event) {
+        event->RegistryPrev = NULL;
+        event->RegistryNext = registry.Head;
+        if (registry.Head != NULL) {
+            registry.Head->RegistryPrev = event;
+        }
+        registry.Head = event;
+        event->Registered = true;
+        ++registry.Count;
+    }
+
+    PEVENTS_LOCAL void RegisterEvent(neosmart_event_t event) {
+        neosmart_registry_t_ &registry = Registry();
+        int result = pthread_mutex_lock(&registry.Mutex);
+        assert(result == 0);
+        LinkEvent(registry, event);
+        result = pthread_mutex_unlock(&registry.Mutex);
+        assert(result == 0);
+    }
+
+    PEVENTS_DECL void detail::UnregisterEvent(neosmart_event_t event) {
+        neosmart_registry_t_ &registry = Registry();
+        int result = pthread_mutex_lock(&registry.Mutex);
+        assert(result == 0);
+        if (event->Registered) {
+            if (event->RegistryPrev != NULL) {
+                event->RegistryPrev->RegistryNext = event->RegistryNext;
+            } else {
+                registry.Head = event->RegistryNext;
+            }
+            if (event->RegistryNext != NULL) {
+                event->RegistryNext->RegistryPrev = event->RegistryPrev;
+            }
+            event->Registered = false;
+            --registry.Count;
+        }
+        result = pthread_mutex_unlock(&registry.Mutex);
+        assert(result == 0);
+    }
+#endif // REGISTRY
+
+#if defined(REGISTRY) || defined(ATTRIBUTION)
+    PEVENTS_DECL uint64_t detail::QueryThreadId() {
+#ifdef __linux__
+        return (uint64_t)syscall(SYS_gettid);
+#else
+        static std::atomic<uint64_t> threads{0};
+        return threads.fetch_add(1, std::memory_order_relaxed) + 1;
+#endif
+    }
+#endif
+
+#ifdef NAMED
+#ifndef PEVENTS_MAX_SHARED_WAITS
+#define PEVENTS_MAX_SHARED_WAITS 64
+#endif
+#ifndef PEVENTS_SHARED_WFMO_SLOTS
+#define PEVENTS_SHARED_WFMO_SLOTS 1024
+#endif
+// How long (in milliseconds) to wait for another process to finish creating a segment before
+// concluding that it died part way through
+#ifndef PEVENTS_SEGMENT_TIMEOUT
+#define PEVENTS_SEGMENT_TIMEOUT 1000
+#endif
+
+    // Segments are zero-filled on creation; whoever creates one moves it to SEGMENT_READY once
+    // the process-shared primitives inside have been initialized.
+    enum { SEGMENT_EMPTY = 0, SEGMENT_INITIALIZING = 1, SEGMENT_READY = 2 };
+
+#ifdef WFMO
+    // WFMO waits registered with a named event can't store a neosmart_wfmo_t pointer, since the
+    // event may be set from another process. They instead refer to a slot in the shared WFMO pool.
+    struct neosmart_shared_wfmo_info_t_ {
+        int Slot;
+        int WaitIndex;
+        uint32_t Generation;
+    };
+
+    // The pool of process-shared neosmart_wfmo_t_ objects, mapped at /dev/shm/pevents.wfmo.
+    // WaitForMultipleEvents() draws its neosmart_wfmo_t_ from here whenever a named event is
+    // involved, so that a SetEvent() from any process can notify the waiter.
+    struct neosmart_wfmo_pool_t_ {
+        std::atomic<uint32_t> Initialized;
+        std::atomic<uint32_t> NextSlot;
+        neosmart_wfmo_t_ Slots[PEVENTS_SHARED_WFMO_SLOTS];
+    };
+#endif
+
+    // The state of a named event, mapped at /dev/shm/pevents.<name> by every process that has it
+    // open. Its primitives are process-shared, but it's otherwise waited on like a local event.
+    struct neosmart_shared_event_t_ : basic_event<runtime_reset, blocking_wait, single_wait> {
+        // Set once the last handle has been closed and the segment unlinked
+        bool Unlinked;
+        std::atomic<uint32_t> Initialized;
+        // SharedEventLayout() of the build that created the segment
+        uint32_t Layout;
+        uint32_t OpenCount;
+#ifdef WFMO
+        int WaitCount;
+        neosmart_shared_wfmo_info_t_ RegisteredWaits[PEVENTS_MAX_SHARED_WAITS];
+#endif
+    };
+#endif // NAMED
+
+#ifdef CAPTURE
+#ifndef PEVENTS_CAPTURE_BUFFER
+#define PEVENTS_CAPTURE_BUFFER (64 * 1024)
+#endif
+    // Every thread appends its records to a buffer of its own, which is written out when full and
+    // when the capture stops. Its mutex is only ever contended by a stopping capture. Buffers are
+    // kept (and used by later captures) after their thread exits.
+    struct neosmart_capture_buffer_t_ {
+        neosmart_capture_buffer_t_ *Next;
+        pthread_mutex_t Mutex;
+        uint32_t Thread;
+        size_t Used;
+        char Data[PEVENTS_CAPTURE_BUFFER];
+    };
+
+    struct neosmart_capture_state_t_ {
+        // Serializes StartCapture() and StopCapture()
+        pthread_mutex_t Control;
+        // Guards the file, the first error writing to it and the list of buffers. Taken with a
+        // buffer's mutex held, never the other way around.
+        pthread_mutex_t Mutex;
+        std::atomic<bool> Active;
+        FILE *File;
+        int Error;
+        // When the capture started, on detail::Now()
+        uint64_t Start;
+        // Bumped by every capture, so that event ids from earlier ones aren't mistaken for current
+        uint32_t Generation;
+        std::atomic<uint32_t> NextEvent;
+        std::atomic<neosmart_capture_buffer_t_ *> Buffers;
+        uint32_t BufferCount;
+    };
+
+    PEVENTS_LOCAL neosmart_capture_state_t_ &CaptureState() {
+        static neosmart_capture_state_t_ state = {PTHREAD_MUTEX_INITIALIZER,
+                                                  PTHREAD_MUTEX_INITIALIZER,
+                                                  {false},
+                                                  NULL,
+                                                  0,
+                                                  0,
+                                                  0,
+                                                  {0},
+                                                  {NULL},
+                                                  0};
+        return state;
+    }
+
+    PEVENTS_LOCAL bool Capturing() {
+        return CaptureState().Active.load(std::memory_order_relaxed);
+    }
+
+    PEVENTS_LOCAL neosmart_capture_buffer_t_ *AllocateCaptureBuffer() {
+        neosmart_capture_state_t_ &state = CaptureState();
+        neosmart_capture_buffer_t_ *buffer = static_cast<neosmart_capture_buffer_t_ *>(
+            Allocate(GetDefaultAllocator(), sizeof(neosmart_capture_buffer_t_),
+                     PEVENTS_CACHE_LINE));
+        if (buffer == NULL) {
+            return NULL;
+        }
+        buffer->Used = 0;
+        int result = pthread_mutex_init(&buffer->Mutex, NULL);
+        assert(result == 0);
+
+        result = pthread_mutex_lock(&state.Mutex);
+        assert(result == 0);
+        buffer->Thread = ++state.BufferCount;
+        buffer->Next = state.Buffers.load(std::memory_order_relaxed);
+        state.Buffers.store(buffer, std::memory_order_release);
+        result = pthread_mutex_unlock(&state.Mutex);
+        assert(result == 0);
+
+        return buffer;
+    }
+
+    PEVENTS_LOCAL neosmart_capture_buffer_t_ *CaptureBuffer() {
+        static thread_local neosmart_capture_buffer_t_ *buffer = AllocateCaptureBuffer();
+        return buffer;
+    }
+
+    // Writes out a buffer whose mutex is held
+    PEVENTS_LOCAL void FlushCaptureBuffer(neosmart_capture_buffer_t_ *buffer) {
+        neosmart_capture_state_t_ &state = CaptureState();
+        int result = pthread_mutex_lock(&state.Mutex);
+        assert(result == 0);
+        if (state.File != NULL && buffer->Used != 0 &&
+            fwrite(buffer->Data, 1, buffer->Used, state.File) != buffer->Used && state.Error == 0) {
+            state.Error = errno != 0 ? errno : EIO;
+        }
+        result = pthread_mutex_unlock(&state.Mutex);
+        assert(result == 0);
+        buffer->Used = 0;
+    }
+
+    // Appends a record, and for WFMO the ids of its events, which have all been given one.
+    // Buffers are only ever written out whole records at a time, as other threads' writes may come
+    // between two of them.
+    PEVENTS_LOCAL void AppendCapture(neosmart_capture_buffer_t_ *buffer,
+                                     const neosmart_capture_record_t &record,
+                                     neosmart_event_t *events = NULL) {
+        size_t size = sizeof(record) + record.Count * sizeof(uint32_t);
+        if (PEVENTS_CAPTURE_BUFFER - buffer->Used < size) {
+            FlushCaptureBuffer(buffer);
+        }
+
+        if (size <= PEVENTS_CAPTURE_BUFFER) {
+            memcpy(buffer->Data + buffer->Used, &record, sizeof(record));
+            buffer->Used += sizeof(record);
+            for (uint32_t i = 0; i < record.Count; ++i) {
+                uint32_t id = (uint32_t)events[i]->CaptureId.load(std::memory_order_relaxed);
+                memcpy(buffer->Data + buffer->Used, &id, sizeof(id));
+                buffer->Used += sizeof(id);
+            }
+            return;
+        }
+
+        // Too large to buffer, and written out directly instead
+        neosmart_capture_state_t_ &state = CaptureState();
+        int result = pthread_mutex_lock(&state.Mutex);
+        assert(result == 0);
+        bool written = state.File == NULL || fwrite(&record, sizeof(record), 1, state.File) == 1;
+        for (uint32_t i = 0; written && state.File != NULL && i < record.Count; ++i) {
+            uint32_t id = (uint32_t)events[i]->CaptureId.load(std::memory_order_relaxed);
+            written = fwrite(&id, sizeof(id), 1, state.File) == 1;
+        }
+        if (!written && state.Error == 0) {
+            state.Error = errno != 0 ? errno : EIO;
+        }
+        result = pthread_mutex_unlock(&state.Mutex);
+        assert(result == 0);
+    }
+
+    // The event's id in the running capture, recording its creation if it has yet to be given
+    // one. The calling thread's buffer is locked.
+    PEVENTS_LOCAL uint32_t CaptureEventId(neosmart_capture_buffer_t_ *buffer,
+                                          neosmart_event_t event) {
+        neosmart_capture_state_t_ &state = CaptureState();
+        uint64_t generation = (uint64_t)state.Generation << 32;
+        uint64_t id = event->CaptureId.load(std::memory_order_relaxed);
+        if ((id & ~(uint64_t)UINT32_MAX) == generation) {
+            return (uint32_t)id;
+        }
+        uint64_t assigned = generation | (state.NextEvent.fetch_add(1) + 1);
+        if (!event->CaptureId.compare_exchange_strong(id, assigned)) {
+            // Another thread got there first, and records the creation
+            return (uint32_t)id;
+        }
+
+        bool set = event->State.load(std::memory_order_relaxed);
+        uint8_t flags = event->AutoReset ? 0 : CAPTURE_MANUAL_RESET;
+#ifdef NAMED
+        if (event->Shared) {
+            set = event->Shared->State.load(std::memory_order_relaxed);
+            flags |= CAPTURE_NAMED;
+        }
+#endif
+        neosmart_capture_record_t record = {};
+        record.Begin = detail::Now() - state.Start;
+        record.Thread = buffer->Thread;
+        record.Event = (uint32_t)assigned;
+        record.Op = CAPTURE_CREATE;
+        record.Flags = flags | (set ? CAPTURE_INITIAL_STATE : 0);
+        AppendCapture(buffer, record);
+        return (uint32_t)assigned;
+    }
+
+    // Records a call that began at `begin` (on detail::Now()) and has just returned `result`.
+    // For waits on multiple events, `event` is the one reported as having woken the wait.
+    PEVENTS_LOCAL void CaptureCall(uint8_t op, uint8_t flags, neosmart_event_t event,
+                                   uint64_t begin, uint64_t timeout, int result,
+                                   neosmart_event_t *events = NULL, int count = 0) {
+        neosmart_capture_state_t_ &state = CaptureState();
+        neosmart_capture_buffer_t_ *buffer = CaptureBuffer();
+        if (buffer == NULL) {
+            return;
+        }
+        int tempResult = pthread_mutex_lock(&buffer->Mutex);
+        assert(tempResult == 0);
+        // Checked again with the buffer locked, as a stopping capture flushes every buffer
+        if (state.Active.load(std::memory_order_acquire)) {
+            for (int i = 0; i < count; ++i) {
+                CaptureEventId(buffer, events[i]);
+            }
+
+            neosmart_capture_record_t record = {};
+            // Calls begun before the capture started are recorded as starting with it
+            record.Begin = begin > state.Start ? begin - state.Start : 0;
+            record.Duration = detail::Now() - begin;
+            record.Timeout = timeout;
+            record.Thread = buffer->Thread;
+            record.Event = CaptureEventId(buffer, event);
+            record.Result = result;
+            record.Count = (uint32_t)count;
+            record.Op = op;
+            record.Flags = flags;
+            AppendCapture(buffer, record, events);
+        }
+        tempResult = pthread_mutex_unlock(&buffer->Mutex);
+        assert(tempResult == 0);
+    }
+
+    // Gives a newly created event its id, recording the creation
+    PEVENTS_LOCAL void CaptureCreate(neosmart_event_t event) {
+        neosmart_capture_buffer_t_ *buffer = CaptureBuffer();
+        if (buffer == NULL) {
+            return;
+        }
+        int result = pthread_mutex_lock(&buffer->Mutex);
+        assert(result == 0);
+        if (CaptureState().Active.load(std::memory_order_acquire)) {
+            CaptureEventId(buffer, event);
+        }
+        result = pthread_mutex_unlock(&buffer->Mutex);
+        assert(result == 0);
+    }
+
+    PEVENTS_DECL int StartCapture(const char *path) {
+        neosmart_capture_state_t_ &state = CaptureState();
+        int result = pthread_mutex_lock(&state.Control);
+        assert(result == 0);
+        if (state.File != NULL) {
+            result = pthread_mutex_unlock(&state.Control);
+            assert(result == 0);
+            return EBUSY;
+        }
+
+        int error = 0;
+        FILE *file = fopen(path, "wb");
+        neosmart_capture_header_t header = {{'p', 'e', 'v', 'e', 'n', 't', 's', '\0'},
+                                            CAPTURE_VERSION,
+                                            sizeof(neosmart_capture_record_t)};
+        if (file == NULL) {
+            error = errno;
+        } else if (fwrite(&header, sizeof(header), 1, file) != 1) {
+            error = errno != 0 ? errno : EIO;
+            fclose(file);
+        } else {
+            result = pthread_mutex_lock(&state.Mutex);
+            assert(result == 0);
+            state.File = file;
+            state.Error = 0;
+            ++state.Generation;
+            state.NextEvent.store(0, std::memory_order_relaxed);
+            state.Start = detail::Now();
+            result = pthread_mutex_unlock(&state.Mutex);
+            assert(result == 0);
+            state.Active.store(true, std::memory_order_release);
+        }
+
+        result = pthread_mutex_unlock(&state.Control);
+        assert(result == 0);
+        return error;
+    }
+
+    PEVENTS_DECL int StopCapture() {
+        neosmart_capture_state_t_ &state = CaptureState();
+        int result = pthread_mutex_lock(&state.Control);
+        assert(result == 0);
+        if (state.File == NULL) {
+            result = pthread_mutex_unlock(&state.Control);
+            assert(result == 0);
+            return ESRCH;
+        }
+
+        // Threads check again with their buffer locked, so nothing is added to a buffer once
+        // it's been flushed here
+        state.Active.store(false, std::memory_order_release);
+        for (neosmart_capture_buffer_t_ *buffer = state.Buffers.load(std::memory_order_acquire);
+             buffer != NULL; buffer = buffer->Next) {
+            result = pthread_mutex_lock(&buffer->Mutex);
+            assert(result == 0);
+            FlushCaptureBuffer(buffer);
+            result = pthread_mutex_unlock(&buffer->Mutex);
+            assert(result == 0);
+        }
+
+        result = pthread_mutex_lock(&state.Mutex);
+        assert(result == 0);
+        int error = state.Error;
+        if (fclose(state.File) != 0 && error == 0) {
+            error = errno;
+        }
+        state.File = NULL;
+        result = pthread_mutex_unlock(&state.Mutex);
+        assert(result == 0);
+
+        result = pthread_mutex_unlock(&state.Control);
+        assert(result == 0);
+        return error;
+    }
+#endif // CAPTURE
+
+    // Whether a registered wait refers to an earlier use of a shared WFMO slot, since taken back
+    // from a process that died using it. Called with the waiter's mutex held.
+    PEVENTS_LOCAL bool IsStaleWait(const neosmart_wfmo_info_t_ &wait) {
+#ifdef NAMED
+        return wait.Generation != wait.Waiter->Generation;
+#else
+        (void)wait;
+        return false;
+#endif
+    }
+
+    // Releases a neosmart_wfmo_t_ once the last reference to it has been dropped
+    PEVENTS_LOCAL void FreeWfmo(neosmart_wfmo_t wfmo) {
+#ifdef NAMED
+        if (wfmo->Slot >= 0) {
+            // Shared slots keep their (process-shared) primitives and are only marked as free
+            wfmo->OwnerStart.store(0, std::memory_order_relaxed);
+            wfmo->InUse.store(0, std::memory_order_release);
+            return;
+        }
+#endif
+        wfmo->Destroy();
+        Deallocate(wfmo->Allocator, wfmo, sizeof(neosmart_wfmo_t_), alignof(neosmart_wfmo_t_));
+    }
+
+    PEVENTS_LOCAL bool RemoveExpiredWaitHelper(neosmart_wfmo_info_t_ wait) {
+        pthread_mutex_t *mutex = &wait.Waiter->Mutex;
+        int result = detail::Recover(mutex, pthread_mutex_trylock(mutex));
+
+        if (result == EBUSY) {
+#ifdef CONTENTION
+            // Never waited for; the wait is left to be cleaned up another time
+            AddWait(ContentionTable().Waiters[LOCK_OP_CLEANUP], 0);
+#endif
+            return false;
+        }
+
+        assert(result == 0);
+
+        if (IsStaleWait(wait)) {
+            // Holds no reference to the waiter now using the slot
+            result = pthread_mutex_unlock(mutex);
+            assert(result == 0);
+            return true;
+        }
+
+        if (wait.Waiter->StillWaiting == false) {
+            PEVENTS_PROBE2(wait_expired, wait.Waiter, wait.WaitIndex);
+            --wait.Waiter->RefCount;
+            assert(wait.Waiter->RefCount >= 0);
+            bool destroy = wait.Waiter->RefCount == 0;
+            result = pthread_mutex_unlock(&wait.Waiter->Mutex);
+            assert(result == 0);
+            if (destroy) {
+                FreeWfmo(wait.Waiter);
+            }
+
+            return true;
+        }
+
+        result = pthread_mutex_unlock(&wait.Waiter->Mutex);
+        assert(result == 0);
+
+        return false;
+    }
+
+    PEVENTS_DECL uint32_t detail::RemoveExpiredWaits(neosmart_wait_list_t_ &waits) {
+        uint32_t count = waits.Count;
+        waits.Truncate(std::remove_if(waits.Begin(), waits.End(), RemoveExpiredWaitHelper));
+        return count - waits.Count;
+    }
+
+    // Hands the event over to a registered WFMO waiter. Returns false (after releasing the event's
+    // reference to it) if the waiter has since stopped waiting and the event wasn't consumed.
+    PEVENTS_LOCAL bool SignalRegisteredWait(neosmart_wfmo_info_t_ info) {
+#ifdef CONTENTION
+        LockWaiter(info.Waiter, LOCK_OP_SET);
+        int result;
+#else
+        pthread_mutex_t *mutex = &info.Waiter->Mutex;
+        int result = detail::Recover(mutex, pthread_mutex_lock(mutex));
+        assert(result == 0);
+#endif
+
+        if (IsStaleWait(info)) {
+            result = pthread_mutex_unlock(&info.Waiter->Mutex);
+            assert(result == 0);
+            return false;
+        }
+
+        --info.Waiter->RefCount;
+        assert(info.Waiter->RefCount >= 0);
+        if (!info.Waiter->StillWaiting) {
+            bool destroy = info.Waiter->RefCount == 0;
+            result = pthread_mutex_unlock(&info.Waiter->Mutex);
+            assert(result == 0);
+            if (destroy) {
+                FreeWfmo(info.Waiter);
+            }
+            return false;
+        }
+
+#ifdef PEVENTS_WAKE_SAMPLES
+#ifdef LATENCY
+        info.Waiter->SignalTime = detail::Now();
+#endif
+#ifdef TRACE
+        info.Waiter->SignalFlow = detail::TraceFlow();
+#endif
+#ifdef ATTRIBUTION
+        info.Waiter->SignalBy = detail::SetAttribution();
+#endif
+        info.Waiter->SignalIndex = info.WaitIndex;
+#endif
+        if (info.Waiter->WaitAll) {
+            --info.Waiter->Status.EventsLeft;
+            assert(info.Waiter->Status.EventsLeft >= 0);
+            // We technically should do i->Waiter->StillWaiting = Waiter->Status.EventsLeft != 0
+            // but the only time it'll be equal to zero is if we're the last event, so no one else
+            // will be checking the StillWaiting flag. We're good to go without it.
+        } else {
+            info.Waiter->Status.FiredEvent = info.WaitIndex;
+            info.Waiter->StillWaiting = false;
+        }
+
+        result = pthread_mutex_unlock(&info.Waiter->Mutex);
+        assert(result == 0);
+
+        result = pthread_cond_signal(&info.Waiter->CVariable);
+        assert(result == 0);
+
+        return true;
+    }
+
+    PEVENTS_DECL bool detail::SignalOneWaiter(neosmart_wait_list_t_ &waits) {
+#ifdef NUMA
+        // Any one waiter may be given an auto-reset event, so prefer one on this node
+        waits.PromoteNode(GetCurrentNumaNode());
+#endif
+        while (!waits.Empty()) {
+            if (SignalRegisteredWait(waits.PopFront())) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    PEVENTS_DECL void detail::SignalAllWaiters(neosmart_wait_list_t_ &waits) {
+#ifdef NUMA
+        // Everyone is woken either way, but waiters on this node go first. Signalled entries
+        // are cleared, as the waiter may be freed as soon as we've let go of it.
+        int node = GetCurrentNumaNode();
+        for (neosmart_wfmo_info_t info = waits.Begin(); info != waits.End(); ++info) {
+            if (info->Waiter->Node == node) {
+                SignalRegisteredWait(*info);
+                info->Waiter = NULL;
+            }
+        }
+#endif
+        for (neosmart_wfmo_info_t info = waits.Begin(); info != waits.End(); ++info) {
+            if (info->Waiter != NULL) {
+                SignalRegisteredWait(*info);
+            }
+        }
+        waits.Truncate(waits.Begin());
+    }
+
+#ifdef NAMED
+    PEVENTS_LOCAL uint64_t SegmentClock() {
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / (1000 * 1000);
+    }
+
+    // Yields to the process creating a segment. Returns false once PEVENTS_SEGMENT_TIMEOUT has
+    // passed since `start`.
+    PEVENTS_LOCAL bool YieldToCreator(uint64_t start) {
+        if (SegmentClock() - start > PEVENTS_SEGMENT_TIMEOUT) {
+            return false;
+        }
+        sched_yield();
+        return true;
+    }
+
+    // Waits for the creator of an existing segment to size it, and checks that it's `size` bytes:
+    // any other size means it was made by a build of pevents with a different layout. Returns 0
+    // or an errno value.
+    PEVENTS_LOCAL int CheckSegmentSize(int fd, size_t size) {
+        uint64_t start = SegmentClock();
+        struct stat st;
+        while (fstat(fd, &st) == 0) {
+            if (st.st_size != 0) {
+                return (size_t)st.st_size == size ? 0 : EINVAL;
+            }
+            if (!YieldToCreator(start)) {
+                return ETIMEDOUT;
+            }
+        }
+        return errno;
+    }
+
+    // Maps the shared memory segment with the given name, first creating and sizing it if `create`
+    // is set and it doesn't exist. Sets `created` if this call created the segment, in which case
+    // the caller must initialize it. Returns NULL with errno set on failure.
+    PEVENTS_LOCAL void *MapSegment(const char *name, size_t size, bool create, bool &created) {
+        created = false;
+        int fd = -1;
+        if (create) {
+            fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0666);
+            if (fd >= 0) {
+                created = true;
+                if (ftruncate(fd, size) != 0) {
+                    int error = errno;
+                    close(fd);
+                    shm_unlink(name);
+                    errno = error;
+                    return NULL;
+                }
+            } else if (errno != EEXIST) {
+                return NULL;
+            }
+        }
+        if (fd < 0) {
+            fd = shm_open(name, O_RDWR, 0666);
+            if (fd < 0) {
+                return NULL;
+            }
+            int error = CheckSegmentSize(fd, size);
+            if (error != 0) {
+                close(fd);
+                errno = error;
+                return NULL;
+            }
+        }
+
+        void *mapping = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        int error = errno;
+        close(fd);
+        errno = error;
+        return mapping == MAP_FAILED ? NULL : mapping;
+    }
+
+    // Waits for the creator of a segment to make it ready. Returns false if it doesn't within
+    // PEVENTS_SEGMENT_TIMEOUT, as happens should it die part way through.
+    PEVENTS_LOCAL bool WaitForSegment(std::atomic<uint32_t> &initialized) {
+        uint64_t start = SegmentClock();
+        while (initialized.load(std::memory_order_acquire) != SEGMENT_READY) {
+            if (!YieldToCreator(start)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    PEVENTS_LOCAL void InitSharedCondition(pthread_cond_t *cond);
+
+    PEVENTS_LOCAL void InitSharedPrimitives(pthread_mutex_t *mutex, pthread_cond_t *cond) {
+        pthread_mutexattr_t mutexAttr;
+        int result = pthread_mutexattr_init(&mutexAttr);
+        assert(result == 0);
+        result = pthread_mutexattr_setpshared(&mutexAttr, PTHREAD_PROCESS_SHARED);
+        assert(result == 0);
+#ifdef PEVENTS_ROBUST_MUTEXES
+        result = pthread_mutexattr_setrobust(&mutexAttr, PTHREAD_MUTEX_ROBUST);
+        assert(result == 0);
+#endif
+        result = pthread_mutex_init(mutex, &mutexAttr);
+        assert(result == 0);
+        pthread_mutexattr_destroy(&mutexAttr);
+        InitSharedCondition(cond);
+    }
+
+    PEVENTS_LOCAL void InitSharedCondition(pthread_cond_t *cond) {
+        pthread_condattr_t condAttr;
+        int result = pthread_condattr_init(&condAttr);
+        assert(result == 0);
+        result = pthread_condattr_setpshared(&condAttr, PTHREAD_PROCESS_SHARED);
+        assert(result == 0);
+        result = pthread_cond_init(cond, &condAttr);
+        assert(result == 0);
+        pthread_condattr_destroy(&condAttr);
+    }
+
+    // Identifies the build options that shape neosmart_shared_event_t_ and the shared WFMO pool.
+    // Segments made by a build whose structures differ in size are already turned away by
+    // MapSegment(); this catches those whose layout differs all the same.
+    enum { SHARED_EVENT_VERSION = 1 };
+
+    PEVENTS_LOCAL uint32_t SharedEventLayout() {
+        uint32_t options = 0;
+#ifdef WFMO
+        options |= 1 << 0;
+#endif
+#ifdef STATS
+        options |= 1 << 1;
+#endif
+#ifdef LATENCY
+        options |= 1 << 2;
+#endif
+#ifdef TRACE
+        options |= 1 << 3;
+#endif
+#ifdef ATTRIBUTION
+        options |= 1 << 4;
+#endif
+#ifdef REGISTRY
+        options |= 1 << 5;
+#endif
+#ifdef WATCHDOG
+        options |= 1 << 6;
+#endif
+#ifdef CONTENTION
+        options |= 1 << 7;
+#endif
+#ifdef CAPTURE
+        options |= 1 << 8;
+#endif
+#ifdef NUMA
+        options |= 1 << 9;
+#endif
+        return (uint32_t)SHARED_EVENT_VERSION << 16 | options;
+    }
+
+#ifdef WFMO
+    PEVENTS_LOCAL neosmart_wfmo_pool_t_ *SharedWfmoPool() {
+        static neosmart_wfmo_pool_t_ *pool = []() {
+            // Another process may have created the pool, but that's fine so long as it's ready. The
+            // pool outlives any one process, so its name is tied to its layout to keep builds with
+            // different options or versions from sharing it. PEVENTS_WFMO_POOL names a pool to use
+            // instead, for processes that should keep to themselves (as the tests do).
+            char name[256];
+            const char *poolName = getenv("PEVENTS_WFMO_POOL");
+            if (poolName != NULL) {
+                snprintf(name, sizeof(name), "%s", poolName);
+            } else {
+                snprintf(name, sizeof(name), "/pevents.wfmo.%x.%zx", SharedEventLayout(),
+                         sizeof(neosmart_wfmo_pool_t_));
+            }
+            bool created;
+            neosmart_wfmo_pool_t_ *pool = static_cast<neosmart_wfmo_pool_t_ *>(
+                MapSegment(name, sizeof(neosmart_wfmo_pool_t_), true, created));
+            if (pool == NULL) {
+                return pool;
+            }
+
+            uint32_t expected = SEGMENT_EMPTY;
+            if (pool->Initialized.compare_exchange_strong(expected, SEGMENT_INITIALIZING)) {
+                for (int i = 0; i < PEVENTS_SHARED_WFMO_SLOTS; ++i) {
+                    InitSharedPrimitives(&pool->Slots[i].Mutex, &pool->Slots[i].CVariable);
+                    pool->Slots[i].Slot = i;
+                }
+                pool->Initialized.store(SEGMENT_READY, std::memory_order_release);
+            }
+            if (!WaitForSegment(pool->Initialized)) {
+                munmap(pool, sizeof(neosmart_wfmo_pool_t_));
+                return (neosmart_wfmo_pool_t_ *)NULL;
+            }
+            return pool;
+        }();
+        return pool;
+    }
+
+    // When the process `pid` started, in clock ticks since boot, or 0 if that can't be told (as
+    // on platforms without procfs). Only compared with other start times.
+    PEVENTS_LOCAL uint64_t ProcessStartTime(uint32_t pid) {
+#ifdef __linux__
+        char path[32];
+        snprintf(path, sizeof(path), "/proc/%u/stat", pid);
+        FILE *file = fopen(path, "r");
+        if (file == NULL) {
+            return 0;
+        }
+        char stat[1024];
+        size_t length = fread(stat, 1, sizeof(stat) - 1, file);
+        fclose(file);
+        stat[length] = '\0';
+
+        // The start time is the 22nd field, counting from the pid. The second is the executable's
+        // name in parentheses, which may itself contain spaces and parentheses.
+        const char *field = strrchr(stat, ')');
+        for (int i = 2; field != NULL && i < 22; ++i) {
+            field = strchr(field + 1, ' ');
+        }
+        return field != NULL ? strtoull(field + 1, NULL, 10) : 0;
+#else
+        (void)pid;
+        return 0;
+#endif
+    }
+
+    PEVENTS_LOCAL uint64_t SelfStartTime() {
+        static uint64_t start = ProcessStartTime((uint32_t)getpid());
+        return start;
+    }
+
+    // Whether `owner` (which started at `start`, if known) has exited. A process that has since
+    // been given the same pid only passes for the owner where start times aren't available.
+    PEVENTS_LOCAL bool OwnerExited(uint32_t owner, uint64_t start) {
+        if (kill((pid_t)owner, 0) != 0 && errno == ESRCH) {
+            return true;
+        }
+        uint64_t current = start != 0 ? ProcessStartTime(owner) : 0;
+        return current != 0 && current != start;
+    }
+
+    // Takes back a slot from `owner`, a process that died using it, if it still holds it. Waits
+    // registered on the dead waiter's behalf are left where they are, and dropped as stale
+    // wherever they're next come across.
+    PEVENTS_LOCAL void ReclaimSharedWfmo(neosmart_wfmo_t wfmo, uint32_t owner, uint64_t start) {
+        int result = detail::Recover(&wfmo->Mutex, pthread_mutex_lock(&wfmo->Mutex));
+        assert(result == 0);
+        if (wfmo->InUse.load(std::memory_order_relaxed) == owner &&
+            wfmo->OwnerStart.load(std::memory_order_relaxed) == start) {
+            ++wfmo->Generation;
+            wfmo->StillWaiting = false;
+            wfmo->RefCount = 0;
+            // The dead waiter is still accounted for in the condition variable, where it would
+            // swallow signals meant for the slot's next user, so it's started afresh. Only the
+            // slot's user ever waits on it, and it's only ever signalled with the mutex held. (The
+            // robust mutex itself was made consistent on being locked above.)
+            memset(static_cast<void *>(&wfmo->CVariable), 0, sizeof(wfmo->CVariable));
+            InitSharedCondition(&wfmo->CVariable);
+            wfmo->OwnerStart.store(0, std::memory_order_relaxed);
+            // Last, so that no other process can take the slot while it's being reset
+            wfmo->InUse.store(0, std::memory_order_release);
+        }
+        result = pthread_mutex_unlock(&wfmo->Mutex);
+        assert(result == 0);
+    }
+
+    PEVENTS_LOCAL neosmart_wfmo_t AllocateSharedWfmo() {
+        neosmart_wfmo_pool_t_ *pool = SharedWfmoPool();
+        if (pool == NULL) {
+            return NULL;
+        }
+
+        uint32_t self = (uint32_t)getpid();
+        uint32_t start = pool->NextSlot.fetch_add(1, std::memory_order_relaxed);
+        for (int attempt = 0; attempt < 2; ++attempt) {
+            for (uint32_t i = 0; i < PEVENTS_SHARED_WFMO_SLOTS; ++i) {
+                neosmart_wfmo_t wfmo = &pool->Slots[(start + i) % PEVENTS_SHARED_WFMO_SLOTS];
+                uint32_t expected = 0;
+                if (wfmo->InUse.compare_exchange_strong(expected, self,
+                                                        std::memory_order_acquire)) {
+                    wfmo->OwnerStart.store(SelfStartTime(), std::memory_order_relaxed);
+                    return wfmo;
+                }
+            }
+
+            // Every slot is taken. Those of processes that died while waiting are never given
+            // back otherwise, so take them back and look again.
+            if (attempt == 0) {
+                for (neosmart_wfmo_t_ &slot : pool->Slots) {
+                    uint32_t owner = slot.InUse.load(std::memory_order_relaxed);
+                    uint64_t start = slot.OwnerStart.load(std::memory_order_relaxed);
+                    if (owner != 0 && OwnerExited(owner, start)) {
+                        ReclaimSharedWfmo(&slot, owner, start);
+                    }
+                }
+            }
+        }
+
+        return NULL;
+    }
+
+    PEVENTS_LOCAL neosmart_wfmo_info_t_
+    ResolveSharedWait(const neosmart_shared_wfmo_info_t_ &wait) {
+        neosmart_wfmo_info_t_ info;
+        info.Waiter = &SharedWfmoPool()->Slots[wait.Slot];
+        info.WaitIndex = wait.WaitIndex;
+        info.Generation = wait.Generation;
+        return info;
+    }
+
+    PEVENTS_LOCAL void RemoveExpiredSharedWaits(neosmart_shared_event_t_ *shared) {
+        int kept = 0;
+        for (int i = 0; i < shared->WaitCount; ++i) {
+            if (!RemoveExpiredWaitHelper(ResolveSharedWait(shared->RegisteredWaits[i]))) {
+                shared->RegisteredWaits[kept++] = shared->RegisteredWaits[i];
+            }
+        }
+#ifdef STATS
+        detail::Count(shared->Counters, &detail::event_counters::ExpiredWaitsRemoved,
+                      shared->WaitCount - kept);
+#endif
+        shared->WaitCount = kept;
+    }
+#endif // WFMO
+
+    // Named events are backed by /dev/shm/pevents.<name>; path separators (as found in WIN32
+    // names such as "Global\foo") can't be used in POSIX shared memory object names.
+    PEVENTS_LOCAL char *SharedEventName(const neosmart_allocator_t *allocator, const char *name) {
+        const char prefix[] = "/pevents.";
+        size_t length = strlen(name);
+        char *result = static_cast<char *>(Allocate(allocator, sizeof(prefix) + length, 1));
+        if (result == NULL) {
+            return NULL;
+        }
+        memcpy(result, prefix, sizeof(prefix) - 1);
+        for (size_t i = 0; i <= length; ++i) {
+            char c = name[i];
+            result[sizeof(prefix) - 1 + i] = (c == '/' || c == '\\') ? '_' : c;
+        }
+        return result;
+    }
+
+    PEVENTS_LOCAL void FreeSharedEvent(const neosmart_allocator_t *allocator, char *name,
+                                       neosmart_event_t event) {
+        if (name != NULL) {
+            Deallocate(allocator, name, strlen(name) + 1, 1);
+        }
+        if (event != NULL) {
+            Deallocate(allocator, event, sizeof(neosmart_event_t_), alignof(neosmart_event_t_));
+        }
+    }
+
+    PEVENTS_LOCAL neosmart_event_t OpenSharedEvent(const char *name, bool create, bool manualReset,
+                                                   bool initialState) {
+#ifdef WFMO
+        // Map the WFMO pool up front so that SetEvent() can always reach cross-process waiters
+        if (SharedWfmoPool() == NULL) {
+            return NULL;
+        }
+#endif
+
+        const neosmart_allocator_t *allocator = GetDefaultAllocator();
+        char *sharedName = SharedEventName(allocator, name);
+        neosmart_event_t event = static_cast<neosmart_event_t>(
+            Allocate(allocator, sizeof(neosmart_event_t_), alignof(neosmart_event_t_)));
+        if (sharedName == NULL || event == NULL) {
+            FreeSharedEvent(allocator, sharedName, event);
+            return NULL;
+        }
+
+        neosmart_shared_event_t_ *shared = NULL;
+        while (shared == NULL) {
+            bool created = false;
+            shared = static_cast<neosmart_shared_event_t_ *>(
+                MapSegment(sharedName, sizeof(neosmart_shared_event_t_), create, created));
+            if (shared == NULL) {
+                int error = errno;
+                FreeSharedEvent(allocator, sharedName, event);
+                errno = error;
+                return NULL;
+            }
+
+            if (created) {
+                new (shared) neosmart_shared_event_t_;
+                InitSharedPrimitives(&shared->Mutex, &shared->CVariable);
+#ifdef CONTENTION
+                // The contention table is per process, and can't be pointed to from here
+                shared->ProfileSlot = detail::PROFILE_DISABLED;
+#endif
+#ifdef REGISTRY
+                // Waiters in other processes would link in pointers to their own stacks
+                shared->TrackWaiters = false;
+#endif
+                shared->AutoReset = !manualReset;
+                shared->State.store(initialState, std::memory_order_relaxed);
+                shared->Layout = SharedEventLayout();
+                shared->Initialized.store(SEGMENT_READY, std::memory_order_release);
+            }
+            int error = 0;
+            if (!WaitForSegment(shared->Initialized)) {
+                error = ETIMEDOUT;
+            } else if (shared->Layout != SharedEventLayout()) {
+                error = EINVAL;
+            }
+            if (error != 0) {
+                munmap(shared, sizeof(neosmart_shared_event_t_));
+                FreeSharedEvent(allocator, sharedName, event);
+                errno = error;
+                return NULL;
+            }
+
+            int result = detail::Recover(&shared->Mutex, pthread_mutex_lock(&shared->Mutex));
+            assert(result == 0);
+            bool unlinked = shared->Unlinked;
+            if (!unlinked) {
+                ++shared->OpenCount;
+            }
+            result = pthread_mutex_unlock(&shared->Mutex);
+            assert(result == 0);
+
+            if (unlinked) {
+                // We raced with the last handle being closed; start over with a fresh segment
+                munmap(shared, sizeof(neosmart_shared_event_t_));
+                shared = NULL;
+                if (!create) {
+                    FreeSharedEvent(allocator, sharedName, event);
+                    return NULL;
+                }
+            }
+        }
+
+        new (event) neosmart_event_t_();
+        event->Allocator = allocator;
+        event->AutoReset = shared->AutoReset;
+        event->Shared = shared;
+        event->SharedName = sharedName;
+        PEVENTS_PROBE3(create, event, !event->AutoReset,
+                       shared->State.load(std::memory_order_relaxed));
+#ifdef REGISTRY
+        RegisterEvent(event);
+#endif
+#ifdef CAPTURE
+        if (Capturing()) {
+            CaptureCreate(event);
+        }
+#endif
+        return event;
+    }
+
+    PEVENTS_DECL neosmart_event_t CreateEvent(const char *name, bool manualReset,
+                                              bool initialState) {
+        return OpenSharedEvent(name, true, manualReset, initialState);
+    }
+
+    PEVENTS_DECL neosmart_event_t OpenEvent(const char *name) {
+        return OpenSharedEvent(name, false, false, false);
+    }
+
+    PEVENTS_LOCAL int DestroySharedEvent(neosmart_event_t event) {
+        neosmart_shared_event_t_ *shared = event->Shared;
+#ifdef REGISTRY
+        // Before the segment a dump might be reading goes away
+        detail::UnregisterEvent(event);
+#endif
+
+        int result = detail::Recover(&shared->Mutex, pthread_mutex_lock(&shared->Mutex));
+        assert(result == 0);
+#ifdef WFMO
+        RemoveExpiredSharedWaits(shared);
+#endif
+        if (--shared->OpenCount == 0) {
+            shared->Unlinked = true;
+            shm_unlink(event->SharedName);
+        }
+        result = pthread_mutex_unlock(&shared->Mutex);
+        assert(result == 0);
+
+        munmap(shared, sizeof(neosmart_shared_event_t_));
+        const neosmart_allocator_t *allocator = event->Allocator;
+        char *sharedName = event->SharedName;
+        event->~neosmart_event_t_();
+        FreeSharedEvent(allocator, sharedName, event);
+
+        return 0;
+    }
+
+    PEVENTS_LOCAL int SetSharedEvent(neosmart_shared_event_t_ *shared) {
+        int result = detail::Recover(&shared->Mutex, pthread_mutex_lock(&shared->Mutex));
+        assert(result == 0);
+
+        PEVENTS_COUNT(shared->Counters, Sets);
+        if (shared->State.load(std::memory_order_relaxed)) {
+            PEVENTS_COUNT(shared->Counters, RedundantSets);
+        }
+#ifdef LATENCY
+        shared->SetTime.store(detail::Now(), std::memory_order_relaxed);
+#endif
+#ifdef TRACE
+        shared->SetFlow.store(detail::TraceFlow(), std::memory_order_relaxed);
+#endif
+#ifdef ATTRIBUTION
+        shared->SetBy = detail::SetAttribution();
+#endif
+
+        if (shared->AutoReset) {
+            bool consumed = false;
+#ifdef WFMO
+            int popped = 0;
+            while (!consumed && popped < shared->WaitCount) {
+                neosmart_shared_wfmo_info_t_ wait = shared->RegisteredWaits[popped++];
+                consumed = SignalRegisteredWait(ResolveSharedWait(wait));
+            }
+            shared->WaitCount -= popped;
+            memmove(shared->RegisteredWaits, shared->RegisteredWaits + popped,
+                    shared->WaitCount * sizeof(shared->RegisteredWaits[0]));
+#endif
+            if (!consumed) {
+                shared->State.store(true, std::memory_order_release);
+            }
+            result = pthread_mutex_unlock(&shared->Mutex);
+            assert(result == 0);
+
+            if (!consumed) {
+                result = pthread_cond_signal(&shared->CVariable);
+                assert(result == 0);
+            }
+        } else {
+            shared->State.store(true, std::memory_order_release);
+#ifdef WFMO
+            for (int i = 0; i < shared->WaitCount; ++i) {
+                SignalRegisteredWait(ResolveSharedWait(shared->RegisteredWaits[i]));
+            }
+            shared->WaitCount = 0;
+#endif
+            result = pthread_mutex_unlock(&shared->Mutex);
+            assert(result == 0);
+
+            result = pthread_cond_broadcast(&shared->CVariable);
+            assert(result == 0);
+        }
+
+        return 0;
+    }
+#ifdef WFMO
+    PEVENTS_DECL int neosmart_event_t_::RegisterWait(const neosmart_wfmo_info_t_ &info,
+                                                     bool &signaled) {
+        if (Shared == NULL) {
+            return basic_event::RegisterWait(info, signaled);
+        }
+
+        int result = detail::Recover(&Shared->Mutex, pthread_mutex_lock(&Shared->Mutex));
+        assert(result == 0);
+
+        RemoveExpiredSharedWaits(Shared);
+
+        int error = 0;
+        signaled = Shared->UnlockedWait(0) == 0;
+        if (!signaled) {
+            if (Shared->WaitCount == PEVENTS_MAX_SHARED_WAITS) {
+                error = ENOSPC;
+            } else {
+                neosmart_shared_wfmo_info_t_ &wait = Shared->RegisteredWaits[Shared->WaitCount++];
+                wait.Slot = info.Waiter->Slot;
+                wait.WaitIndex = info.WaitIndex;
+                wait.Generation = info.Generation;
+                PEVENTS_COUNT(Shared->Counters, WfmoRegistrations);
+            }
+        }
+
+        result = pthread_mutex_unlock(&Shared->Mutex);
+        assert(result == 0);
+
+        return error;
+    }
+#endif
+#endif // NAMED
+
+    PEVENTS_DECL neosmart_wfmo_t detail::AllocateWfmo(bool processShared, bool waitAll, int count) {
+        neosmart_wfmo_t wfmo = NULL;
+#if defined(NAMED) && defined(WFMO)
+        // A named event may be set from another process, so the waiter it notifies must live in
+        // shared memory as well.
+        if (processShared) {
+            wfmo = AllocateSharedWfmo();
+            if (wfmo == NULL) {
+                return NULL;
+            }
+        }
+#else
+        (void)processShared;
+#endif
+        if (wfmo == NULL) {
+            const neosmart_allocator_t *allocator = GetDefaultAllocator();
+            wfmo = static_cast<neosmart_wfmo_t>(
+                Allocate(allocator, sizeof(neosmart_wfmo_t_), alignof(neosmart_wfmo_t_)));
+            if (wfmo == NULL) {
+                return NULL;
+            }
+            new (wfmo) neosmart_wfmo_t_;
+            wfmo->Allocator = allocator;
+#ifdef NAMED
+            wfmo->Slot = -1;
+            wfmo->Generation = 0;
+#endif
+
+            int result = pthread_mutex_init(&wfmo->Mutex, 0);
+            assert(result == 0);
+
+            result = pthread_cond_init(&wfmo->CVariable, 0);
+            assert(result == 0);
+        }
+
+        wfmo->WaitAll = waitAll;
+        wfmo->StillWaiting = true;
+        wfmo->RefCount = 1;
+#ifdef REGISTRY
+        wfmo->ThreadId = detail::CurrentThreadId();
+#endif
+#ifdef WATCHDOG
+        wfmo->Since = detail::Now();
+#endif
+#ifdef NUMA
+        wfmo->Node = GetCurrentNumaNode();
+#endif
+
+        if (waitAll) {
+            wfmo->Status.EventsLeft = count;
+        } else {
+            wfmo->Status.FiredEvent = -1;
+        }
+
+        int result = detail::Recover(&wfmo->Mutex, pthread_mutex_lock(&wfmo->Mutex));
+        assert(result == 0);
+#ifdef CONTENTION
+        wfmo->HoldStart = detail::Now();
+#endif
+
+        return wfmo;
+    }
+
+    PEVENTS_DECL int detail::FinishWfmo(neosmart_wfmo_t wfmo, bool done, int result,
+                                        uint64_t milliseconds, int &waitIndex) {
+        bool waitAll = wfmo->WaitAll;
+#ifdef CONTENTION
+        // Registration holds the waiter's mutex throughout, locking out anyone setting its events
+        AddHold(ContentionTable().Waiters[LOCK_OP_REGISTER], detail::Now() - wfmo->HoldStart);
+#endif
+
+        // `done` is set by the caller in case of WaitAny and at least one event was set.
+        // But we need to check again here if we were doing a WaitAll or else we'll incorrectly
+        // return WAIT_TIMEOUT.
+        if (waitAll && wfmo->Status.EventsLeft == 0) {
+            done = true;
+        }
+
+        timespec ts;
+        if (!done) {
+            if (milliseconds == 0) {
+                result = WAIT_TIMEOUT;
+                done = true;
+            } else if (milliseconds != -1ul) {
+                ts = Deadline(milliseconds);
+            }
+        }
+#ifdef PEVENTS_WAKE_SAMPLES
+        bool blocked = !done;
+#endif
+
+        while (!done) {
+            // One (or more) of the events we're monitoring has been triggered?
+
+            // If we're waiting for all events, assume we're done and check if there's an event that
+            // hasn't fired But if we're waiting for just one event, assume we're not done until we
+            // find a fired event
+            done = (waitAll && wfmo->Status.EventsLeft == 0) ||
+                   (!waitAll && wfmo->Status.FiredEvent != -1);
+
+            if (!done) {
+                if (milliseconds != -1ul) {
+                    result = pthread_cond_timedwait(&wfmo->CVariable, &wfmo->Mutex, &ts);
+                } else {
+                    result = pthread_cond_wait(&wfmo->CVariable, &wfmo->Mutex);
+                }
+                result = detail::Recover(&wfmo->Mutex, result);
+
+                if (result != 0) {
+                    // The wait may have been satisfied just as it timed out, in which case the
+                    // events that satisfied it have already been consumed on our behalf
+                    if ((waitAll && wfmo->Status.EventsLeft == 0) ||
+                        (!waitAll && wfmo->Status.FiredEvent != -1)) {
+                        result = 0;
+                    }
+                    break;
+                }
+            }
+        }
+
+        waitIndex = wfmo->Status.FiredEvent;
+        wfmo->StillWaiting = false;
+#ifdef PEVENTS_WAKE_SAMPLES
+        if (blocked && result == 0) {
+            detail::wake_sample &sample = detail::LastWake();
+#ifdef LATENCY
+            sample.Latency = detail::Now() - wfmo->SignalTime;
+#endif
+#ifdef TRACE
+            sample.Flow = wfmo->SignalFlow;
+#endif
+#ifdef ATTRIBUTION
+            sample.SetBy = wfmo->SignalBy;
+#endif
+            sample.Index = wfmo->SignalIndex;
+            sample.Valid = true;
+        }
+#endif
+
+        --wfmo->RefCount;
+        assert(wfmo->RefCount >= 0);
+        bool destroy = wfmo->RefCount == 0;
+        int tempResult = pthread_mutex_unlock(&wfmo->Mutex);
+        assert(tempResult == 0);
+        if (destroy) {
+            FreeWfmo(wfmo);
+        }
+
+        return result;
+    }
+
+    // Constructs an event in memory obtained from `allocator`, which will also be used for its
+    // internal allocations
+    PEVENTS_LOCAL void InitEvent(neosmart_event_t event, const neosmart_allocator_t *allocator,
+                                 bool manualReset, bool initialState) {
+        new (event) neosmart_event_t_(manualReset, initialState);
+        PEVENTS_PROBE3(create, event, manualReset, initialState);
+        event->Allocator = allocator;
+#ifdef WFMO
+        event->RegisteredWaits.Allocator = allocator;
+#endif
+#ifdef REGISTRY
+        RegisterEvent(event);
+#endif
+#ifdef CAPTURE
+        if (Capturing()) {
+            CaptureCreate(event);
+        }
+#endif
+    }
+
+    PEVENTS_DECL neosmart_event_t CreateEvent(bool manualReset, bool initialState,
+                                              const neosmart_allocator_t *allocator) {
+        neosmart_event_t event = static_cast<neosmart_event_t>(
+            Allocate(allocator, sizeof(neosmart_event_t_), alignof(neosmart_event_t_)));
+        if (event != NULL) {
+            InitEvent(event, allocator, manualReset, initialState);
+        }
+        return event;
+    }
+
+    PEVENTS_DECL neosmart_event_t CreateEvent(bool manualReset, bool initialState) {
+        return CreateEvent(manualReset, initialState, GetDefaultAllocator());
+    }
+
+    // Events created in bulk are laid out back-to-back in a single allocation (optionally one per
+    // cache line), so that walking them - as WaitForMultipleEvents() does - touches memory
+    // sequentially rather than chasing scattered heap pointers.
+    PEVENTS_LOCAL size_t EventStride(int flags) {
+        size_t stride = sizeof(neosmart_event_t_);
+        if (flags & EVENT_CACHE_ALIGNED) {
+            stride = (stride + PEVENTS_CACHE_LINE - 1) & ~(size_t)(PEVENTS_CACHE_LINE - 1);
+        }
+        return stride;
+    }
+
+    // A block of events starts with a header recording its layout, on a cache line of its own so
+    // that the events following it keep their alignment
+    struct neosmart_event_block_t_ {
+        uint32_t Count;
+        uint32_t Stride;
+    };
+    static_assert(sizeof(neosmart_event_block_t_) <= PEVENTS_CACHE_LINE,
+                  "PEVENTS_CACHE_LINE is too small for the event block header");
+
+    // Marks the events of a block already accounted for while checking an array of them
+    enum : uint32_t { BLOCK_INDEX_SEEN = 0x80000000u };
+
+    PEVENTS_LOCAL size_t BlockSize(size_t stride, int count) {
+        return PEVENTS_CACHE_LINE + stride * count;
+    }
+
+    PEVENTS_DECL int CreateEvents(neosmart_event_t *events, int count, int flags) {
+        if (count <= 0) {
+            return 0;
+        }
+
+        const neosmart_allocator_t *allocator = GetDefaultAllocator();
+        size_t stride = EventStride(flags);
+        char *block =
+            static_cast<char *>(Allocate(allocator, BlockSize(stride, count), PEVENTS_CACHE_LINE));
+        if (block == NULL) {
+            return ENOMEM;
+        }
+
+        neosmart_event_block_t_ *header = reinterpret_cast<neosmart_event_block_t_ *>(block);
+        header->Count = count;
+        header->Stride = (uint32_t)stride;
+        block += PEVENTS_CACHE_LINE;
+        for (int i = 0; i < count; ++i) {
+            events[i] = reinterpret_cast<neosmart_event_t>(block + stride * i);
+            InitEvent(events[i], allocator, flags & EVENT_MANUAL_RESET,
+                      flags & EVENT_INITIAL_STATE);
+            events[i]->BlockIndex = i + 1;
+        }
+
+        return 0;
+    }
+
+    PEVENTS_DECL int WaitForEvent(neosmart_event_t event, uint64_t milliseconds) {
+        PEVENTS_PROBE3(wait_begin, event, !event->AutoReset, milliseconds);
+#ifdef TRACE
+        uint64_t begin = TraceClock();
+#endif
+#ifdef CAPTURE
+        uint64_t captureBegin = Capturing() ? detail::Now() : 0;
+#endif
+        int result;
+#ifdef NAMED
+        if (event->Shared) {
+            result = event->Shared->Wait(milliseconds);
+        } else {
+            result = event->Wait(milliseconds);
+        }
+#else
+        result = event->Wait(milliseconds);
+#endif
+#ifdef LATENCY
+        if (result == 0) {
+            event->RecordWake();
+        }
+#endif
+#ifdef TRACE
+        Trace(TRACE_WAIT, event, begin, result == 0 ? WakeFlow() : 0, result);
+#endif
+#ifdef CAPTURE
+        if (captureBegin != 0) {
+            CaptureCall(CAPTURE_WAIT, 0, event, captureBegin, milliseconds, result);
+        }
+#endif
+        PEVENTS_PROBE2(wait_end, event, result);
+        return result;
+    }
+
+#ifdef WFMO
+    PEVENTS_DECL int WaitForMultipleEvents(neosmart_event_t *events, int count, bool waitAll,
+                                           uint64_t milliseconds) {
+        int unused;
+        return WaitForMultipleEvents(events, count, waitAll, milliseconds, unused);
+    }
+
+    PEVENTS_DECL int WaitForMultipleEvents(neosmart_event_t *events, int count, bool waitAll,
+                                           uint64_t milliseconds, int &waitIndex) {
+        PEVENTS_PROBE4(wfmo_begin, events, count, waitAll, milliseconds);
+#ifdef TRACE
+        uint64_t begin = TraceClock();
+#endif
+#ifdef CAPTURE
+        uint64_t captureBegin = Capturing() ? detail::Now() : 0;
+#endif
+        bool processShared = false;
+#ifdef NAMED
+        for (int i = 0; i < count && !processShared; ++i) {
+            processShared = events[i]->Shared != NULL;
+        }
+#endif
+        int result = detail::WaitForMultiple(events, count, waitAll, milliseconds, waitIndex,
+                                             processShared);
+#ifdef LATENCY
+        if (result == 0 && detail::LastWake().Valid) {
+            events[detail::LastWake().Index]->RecordWake();
+        }
+#endif
+#ifdef TRACE
+        // Attributed to the event that woke the wait, or else the first one
+        bool woken = result == 0 && detail::LastWake().Valid;
+        Trace(TRACE_WFMO, events[woken ? detail::LastWake().Index : 0], begin,
+              woken ? WakeFlow() : 0, result);
+#endif
+#ifdef CAPTURE
+        if (captureBegin != 0 && count > 0) {
+            bool signalled = result == 0 && !waitAll;
+            CaptureCall(CAPTURE_WFMO, waitAll ? CAPTURE_WAIT_ALL : 0,
+                        events[signalled ? waitIndex : 0], captureBegin, milliseconds, result,
+                        events, count);
+        }
+#endif
+        PEVENTS_PROBE3(wfmo_end, events, result, waitIndex);
+        return result;
+    }
+#endif // WFMO
+
+    PEVENTS_DECL int DestroyEvent(neosmart_event_t event) {
+        PEVENTS_PROBE1(destroy, event);
+#ifdef CAPTURE
+        if (Capturing()) {
+            CaptureCall(CAPTURE_DESTROY, 0, event, detail::Now(), 0, 0);
+        }
+#endif
+#ifdef NAMED
+        if (event->Shared) {
+            return DestroySharedEvent(event);
+        }
+#endif
+
+        const neosmart_allocator_t *allocator = event->Allocator;
+        event->~neosmart_event_t_();
+        Deallocate(allocator, event, sizeof(neosmart_event_t_), alignof(neosmart_event_t_));
+
+        return 0;
+    }
+
+    PEVENTS_DECL int DestroyEvents(neosmart_event_t *events, int count) {
+        if (count <= 0) {
+            return 0;
+        }
+
+        // The array may have been reordered since, so the block is found from the event that was
+        // created first, and each event is checked to be where that block placed it. Arrays that
+        // aren't every event of one block, as created, are turned away.
+        neosmart_event_t firstEvent = NULL;
+        for (int i = 0; i < count; ++i) {
+            uint32_t index = events[i]->BlockIndex;
+            if (index == 0 || index > (uint32_t)count) {
+                return EINVAL;
+            }
+            if (index == 1) {
+                firstEvent = events[i];
+            }
+        }
+        if (firstEvent == NULL) {
+            return EINVAL;
+        }
+        char *first = reinterpret_cast<char *>(firstEvent);
+        char *block = first - PEVENTS_CACHE_LINE;
+        const neosmart_event_block_t_ *header = reinterpret_cast<neosmart_event_block_t_ *>(block);
+        size_t stride = header->Stride;
+        if (header->Count != (uint32_t)count) {
+            return EINVAL;
+        }
+        for (int i = 0; i < count; ++i) {
+            if (reinterpret_cast<char *>(events[i]) !=
+                first + stride * (events[i]->BlockIndex - 1)) {
+                return EINVAL;
+            }
+        }
+        // Each event is now known to be part of the block; none may be listed twice
+        for (int i = 0; i < count; ++i) {
+            if (events[i]->BlockIndex & BLOCK_INDEX_SEEN) {
+                for (int j = 0; j < i; ++j) {
+                    events[j]->BlockIndex &= ~BLOCK_INDEX_SEEN;
+                }
+                return EINVAL;
+            }
+            events[i]->BlockIndex |= BLOCK_INDEX_SEEN;
+        }
+
+        const neosmart_allocator_t *allocator = events[0]->Allocator;
+        for (int i = 0; i < count; ++i) {
+            PEVENTS_PROBE1(destroy, events[i]);
+#ifdef CAPTURE
+            if (Capturing()) {
+                CaptureCall(CAPTURE_DESTROY, 0, events[i], detail::Now(), 0, 0);
+            }
+#endif
+            events[i]->~neosmart_event_t_();
+        }
+        Deallocate(allocator, block, BlockSize(stride, count), PEVENTS_CACHE_LINE);
+
+        return 0;
+    }
+
+    PEVENTS_DECL int SetEvent(neosmart_event_t event) {
+        PEVENTS_PROBE2(set, event, !event->AutoReset);
+#ifdef TRACE
+        uint64_t begin = TraceClock();
+        uint64_t flow = BeginTraceSet();
+#endif
+#ifdef CAPTURE
+        uint64_t captureBegin = Capturing() ? detail::Now() : 0;
+#endif
+        int result;
+#ifdef NAMED
+        if (event->Shared) {
+            result = SetSharedEvent(event->Shared);
+        } else {
+            result = event->Set();
+        }
+#else
+        result = event->Set();
+#endif
+#ifdef TRACE
+        detail::TraceFlow() = 0;
+        Trace(TRACE_SET, event, begin, flow, result);
+#endif
+#ifdef CAPTURE
+        if (captureBegin != 0) {
+            CaptureCall(CAPTURE_SET, 0, event, captureBegin, 0, result);
+        }
+#endif
+        return result;
+    }
+
+    PEVENTS_DECL int ResetEvent(neosmart_event_t event) {
+        PEVENTS_PROBE1(reset, event);
+#ifdef TRACE
+        Trace(TRACE_RESET, event, TraceClock(), 0, 0);
+#endif
+#ifdef CAPTURE
+        if (Capturing()) {
+            CaptureCall(CAPTURE_RESET, 0, event, detail::Now(), 0, 0);
+        }
+#endif
+#ifdef NAMED
+        if (event->Shared) {
+            return event->Shared->Reset();
+        }
+#endif
+        return event->Reset();
+    }
+
+    PEVENTS_DECL bool IsEventSet(neosmart_event_t event) {
+#ifdef NAMED
+        if (event->Shared) {
+            return event->Shared->IsSet();
+        }
+#endif
+        return event->IsSet();
+    }
+
+#ifdef ATTRIBUTION
+    PEVENTS_DECL int SetEventEx(neosmart_event_t event, uint64_t tag) {
+        detail::set_attribution &attribution = detail::SetAttribution();
+        attribution.ThreadId = detail::CurrentThreadId();
+        attribution.Time = detail::Now();
+        attribution.Tag = tag;
+        int result = SetEvent(event);
+        attribution = detail::set_attribution();
+        return result;
+    }
+
+    PEVENTS_LOCAL void FillWake(neosmart_wake_t *wake, int index) {
+        const detail::set_attribution &setBy = detail::LastWake().SetBy;
+        wake->Index = index;
+        wake->SetterThreadId = setBy.ThreadId;
+        wake->SetNanoseconds = setBy.Time;
+        wake->Tag = setBy.Tag;
+    }
+
+    PEVENTS_DECL int WaitForEventEx(neosmart_event_t event, uint64_t milliseconds,
+                                    neosmart_wake_t *wake) {
+        int result = WaitForEvent(event, milliseconds);
+        if (result == 0) {
+            FillWake(wake, 0);
+        }
+        return result;
+    }
+
+#ifdef WFMO
+    PEVENTS_DECL int WaitForMultipleEventsEx(neosmart_event_t *events, int count, bool waitAll,
+                                             uint64_t milliseconds, neosmart_wake_t *wake) {
+        int index;
+        int result = WaitForMultipleEvents(events, count, waitAll, milliseconds, index);
+        if (result == 0) {
+            // A wait-all that didn't block took its events in order, the last of them last
+            if (detail::LastWake().Valid) {
+                index = detail::LastWake().Index;
+            } else if (waitAll) {
+                index = count - 1;
+            }
+            FillWake(wake, index);
+        }
+        return result;
+    }
+#endif
+#endif
+
+#ifdef CONTENTION
+    PEVENTS_DECL int GetEventContention(neosmart_event_t event,
+                                        neosmart_event_contention_t *contention) {
+        int slot = event->ProfileSlot.load(std::memory_order_relaxed);
+        if (slot < 0 || !SnapshotContention(slot, *contention)) {
+            return ENOENT;
+        }
+        return 0;
+    }
+#endif
+
+#ifdef STATS
+    PEVENTS_DECL int GetEventStats(neosmart_event_t event, neosmart_event_stats_t *stats) {
+#ifdef NAMED
+        if (event->Shared) {
+            // Shared by (and counted across) every process with the event open
+            event->Shared->Counters.Snapshot(*stats);
+            return 0;
+        }
+#endif
+        event->Counters.Snapshot(*stats);
+        return 0;
+    }
+#endif
+
+#ifdef REGISTRY
+#ifndef PEVENTS_DUMP_WAITERS
+#define PEVENTS_DUMP_WAITERS 8
+#endif
+    // The first few waiters of an event, as found by InspectEvent()
+    struct neosmart_waiter_sample_t_ {
+        uint64_t ThreadId;
+        // When a WFSO waiter started waiting
+        uint64_t Since;
+        // The mode of a WFMO waiter, and the position of the event in its call
+        bool WaitAll;
+        int WaitIndex;
+    };
+
+    struct neosmart_event_waiters_t_ {
+        neosmart_waiter_sample_t_ Wfso[PEVENTS_DUMP_WAITERS];
+        neosmart_waiter_sample_t_ Wfmo[PEVENTS_DUMP_WAITERS];
+    };
+
+#ifdef WFMO
+    // Adds a WFMO waiter to the results if it hasn't returned yet
+    PEVENTS_LOCAL void InspectWfmo(const neosmart_wfmo_info_t_ &wait, neosmart_event_info_t &info,
+                                   neosmart_event_waiters_t_ *waiters) {
+        neosmart_wfmo_t wfmo = wait.Waiter;
+        int result = detail::Recover(&wfmo->Mutex, pthread_mutex_lock(&wfmo->Mutex));
+        assert(result == 0);
+        if (wfmo->StillWaiting && !IsStaleWait(wait)) {
+            if (waiters != NULL && info.MultiWaiters < PEVENTS_DUMP_WAITERS) {
+                neosmart_waiter_sample_t_ &waiter = waiters->Wfmo[info.MultiWaiters];
+                waiter.ThreadId = wfmo->ThreadId;
+                waiter.WaitAll = wfmo->WaitAll;
+                waiter.WaitIndex = wait.WaitIndex;
+            }
+            ++info.MultiWaiters;
+        }
+        result = pthread_mutex_unlock(&wfmo->Mutex);
+        assert(result == 0);
+    }
+#endif
+
+    // Fills in everything but the name of a registered event, and (if `waiters` isn't null) who is
+    // waiting on it. The event is only looked at if its mutex is free, so that a dump can't get
+    // stuck behind whatever is holding it up.
+    PEVENTS_LOCAL void InspectEvent(neosmart_event_t event, neosmart_event_info_t &info,
+                                    neosmart_event_waiters_t_ *waiters) {
+        info.Event = event;
+        info.ManualReset = !event->AutoReset;
+        info.Named = false;
+        info.Waiters = 0;
+        info.MultiWaiters = 0;
+#ifdef NAMED
+        if (event->Shared) {
+            neosmart_shared_event_t_ *shared = event->Shared;
+            info.Named = true;
+            info.Waiters = -1;
+            info.State = shared->State.load(std::memory_order_relaxed);
+            if (detail::Recover(&shared->Mutex, pthread_mutex_trylock(&shared->Mutex)) != 0) {
+                info.MultiWaiters = -1;
+                return;
+            }
+#ifdef WFMO
+            for (int i = 0; i < shared->WaitCount; ++i) {
+                InspectWfmo(ResolveSharedWait(shared->RegisteredWaits[i]), info, waiters);
+            }
+#endif
+            int result = pthread_mutex_unlock(&shared->Mutex);
+            assert(result == 0);
+            return;
+        }
+#endif
+        info.State = event->State.load(std::memory_order_relaxed);
+        if (pthread_mutex_trylock(&event->Mutex) != 0) {
+            info.Waiters = info.MultiWaiters = -1;
+            return;
+        }
+        for (detail::wfso_waiter *wfso = event->WfsoWaiters; wfso != NULL; wfso = wfso->Next) {
+            if (waiters != NULL && info.Waiters < PEVENTS_DUMP_WAITERS) {
+                waiters->Wfso[info.Waiters].ThreadId = wfso->ThreadId;
+                waiters->Wfso[info.Waiters].Since = wfso->Since;
+            }
+            ++info.Waiters;
+        }
+#ifdef WFMO
+        for (neosmart_wfmo_info_t wait = event->RegisteredWaits.Begin();
+             wait != event->RegisteredWaits.End(); ++wait) {
+            InspectWfmo(*wait, info, waiters);
+        }
+#endif
+        int result = pthread_mutex_unlock(&event->Mutex);
+        assert(result == 0);
     }
-#endif // WFMO
-
-    int DestroyEvent(neosmart_event_t event) {
-        int result = 0;
 
-#ifdef WFMO
-        result = pthread_mutex_lock(&event->Mutex);
+    PEVENTS_DECL int SetEventName(neosmart_event_t event, const char *name) {
+        neosmart_registry_t_ &registry = Registry();
+        int result = pthread_mutex_lock(&registry.Mutex);
         assert(result == 0);
-        event->RegisteredWaits.erase(std::remove_if(event->RegisteredWaits.begin(),
-                                                    event->RegisteredWaits.end(),
-                                                    RemoveExpiredWaitHelper),
-                                     event->RegisteredWaits.end());
-        result = pthread_mutex_unlock(&event->Mutex);
+        strncpy(event->DebugName, name, PEVENTS_DEBUG_NAME_LENGTH - 1);
+        event->DebugName[PEVENTS_DEBUG_NAME_LENGTH - 1] = '\0';
+        if (!event->Registered) {
+            LinkEvent(registry, event);
+        }
+        result = pthread_mutex_unlock(&registry.Mutex);
         assert(result == 0);
-#endif
+        return 0;
+    }
 
-        result = pthread_cond_destroy(&event->CVariable);
+    PEVENTS_DECL int ListEvents(neosmart_event_info_t *events, int count) {
+        neosmart_registry_t_ &registry = Registry();
+        int result = pthread_mutex_lock(&registry.Mutex);
         assert(result == 0);
-
-        result = pthread_mutex_destroy(&event->Mutex);
+        int i = 0;
+        for (neosmart_event_t event = registry.Head; event != NULL && i < count;
+             event = event->RegistryNext, ++i) {
+            InspectEvent(event, events[i], NULL);
+            memcpy(events[i].Name, event->DebugName, PEVENTS_DEBUG_NAME_LENGTH);
+        }
+        int total = registry.Count;
+        result = pthread_mutex_unlock(&registry.Mutex);
         assert(result == 0);
+        return total;
+    }
 
-        delete event;
+    PEVENTS_LOCAL void DumpWaiterCount(int fd, const char *kind, int waiters) {
+        if (waiters < 0) {
+            dprintf(fd, " %s=?", kind);
+        } else {
+            dprintf(fd, " %s=%d", kind, waiters);
+        }
+    }
 
+    PEVENTS_DECL int DumpEvents(int fd) {
+        neosmart_registry_t_ &registry = Registry();
+        int result = pthread_mutex_lock(&registry.Mutex);
+        assert(result == 0);
+        uint64_t now = detail::Now();
+        dprintf(fd, "pevents: %d live events\n", registry.Count);
+        for (neosmart_event_t event = registry.Head; event != NULL; event = event->RegistryNext) {
+            neosmart_event_info_t info;
+            neosmart_event_waiters_t_ waiters;
+            InspectEvent(event, info, &waiters);
+            dprintf(fd, "event %p \"%s\" %s%s %s", (void *)event, event->DebugName,
+                    info.ManualReset ? "manual" : "auto", info.Named ? " named" : "",
+                    info.State ? "set" : "unset");
+            DumpWaiterCount(fd, "waiters", info.Waiters);
+            DumpWaiterCount(fd, "wfmo", info.MultiWaiters);
+            dprintf(fd, "\n");
+            for (int i = 0; i < std::min(info.Waiters, (int)PEVENTS_DUMP_WAITERS); ++i) {
+                const neosmart_waiter_sample_t_ &waiter = waiters.Wfso[i];
+                dprintf(fd, "  wait tid=%llu for %.3fms\n", (unsigned long long)waiter.ThreadId,
+                        (now - std::min(now, waiter.Since)) / 1e6);
+            }
+            for (int i = 0; i < std::min(info.MultiWaiters, (int)PEVENTS_DUMP_WAITERS); ++i) {
+                const neosmart_waiter_sample_t_ &waiter = waiters.Wfmo[i];
+                dprintf(fd, "  wfmo tid=%llu wait-%s index=%d\n",
+                        (unsigned long long)waiter.ThreadId, waiter.WaitAll ? "all" : "any",
+                        waiter.WaitIndex);
+            }
+        }
+        result = pthread_mutex_unlock(&registry.Mutex);
+        assert(result == 0);
         return 0;
     }
 
-    int SetEvent(neosmart_event_t event) {
-        int result = pthread_mutex_lock(&event->Mutex);
-        assert(result == 0);
+    // Signal handlers can't take locks, so the handler only posts a semaphore for a thread of its
+    // own to dump the registry from
+    struct neosmart_dump_signal_t_ {
+        sem_t Requests;
+        std::atomic<int> Fd;
+        std::atomic<bool> Started;
+    };
 
-        event->State = true;
+    PEVENTS_LOCAL neosmart_dump_signal_t_ &DumpSignal() {
+        static neosmart_dump_signal_t_ dump;
+        return dump;
+    }
 
-        // Depending on the event type, we either trigger everyone or only one
-        if (event->AutoReset) {
-#ifdef WFMO
-            while (!event->RegisteredWaits.empty()) {
-                neosmart_wfmo_info_t i = &event->RegisteredWaits.front();
+    PEVENTS_LOCAL void RequestDump(int) {
+        sem_post(&DumpSignal().Requests);
+    }
 
-                result = pthread_mutex_lock(&i->Waiter->Mutex);
-                assert(result == 0);
+    PEVENTS_LOCAL void *DumpThread(void *) {
+        neosmart_dump_signal_t_ &dump = DumpSignal();
+        while (true) {
+            if (sem_wait(&dump.Requests) == 0) {
+                DumpEvents(dump.Fd.load(std::memory_order_relaxed));
+            }
+        }
+        return NULL;
+    }
 
-                --i->Waiter->RefCount;
-                assert(i->Waiter->RefCount >= 0);
-                if (!i->Waiter->StillWaiting) {
-                    bool destroy = i->Waiter->RefCount == 0;
-                    result = pthread_mutex_unlock(&i->Waiter->Mutex);
-                    assert(result == 0);
-                    if (destroy) {
-                        i->Waiter->Destroy();
-                        delete i->Waiter;
-                    }
-                    event->RegisteredWaits.pop_front();
-                    continue;
-                }
+    PEVENTS_DECL int EnableEventDumpSignal(int signal, int fd) {
+        neosmart_dump_signal_t_ &dump = DumpSignal();
+        dump.Fd.store(fd, std::memory_order_relaxed);
+        if (!dump.Started.exchange(true)) {
+            if (sem_init(&dump.Requests, 0, 0) != 0) {
+                dump.Started.store(false);
+                return errno;
+            }
+            pthread_t thread;
+            int result = pthread_create(&thread, NULL, DumpThread, NULL);
+            if (result != 0) {
+                sem_destroy(&dump.Requests);
+                dump.Started.store(false);
+                return result;
+            }
+            pthread_detach(thread);
+        }
 
-                event->State = false;
+        struct sigaction action;
+        memset(&action, 0, sizeof(action));
+        action.sa_handler = RequestDump;
+        action.sa_flags = SA_RESTART;
+        sigemptyset(&action.sa_mask);
+        if (sigaction(signal, &action, NULL) != 0) {
+            return errno;
+        }
+        return 0;
+    }
+#endif
 
-                if (i->Waiter->WaitAll) {
-                    --i->Waiter->Status.EventsLeft;
-                    assert(i->Waiter->Status.EventsLeft >= 0);
-                    // We technically should do i->Waiter->StillWaiting = Waiter->Status.EventsLeft
-                    // != 0 but the only time it'll be equal to zero is if we're the last event, so
-                    // no one else will be checking the StillWaiting flag. We're good to go without
-                    // it.
-                } else {
-                    i->Waiter->Status.FiredEvent = i->WaitIndex;
-                    i->Waiter->StillWaiting = false;
-                }
+#ifdef WATCHDOG
+#ifndef PEVENTS_WATCHDOG_WAITS
+#define PEVENTS_WATCHDOG_WAITS 256
+#endif
+    // A wait found blocked by the watchdog. A WFMO call is found through each event it's
+    // registered with, and recognized by its neosmart_wfmo_t.
+    struct neosmart_blocked_wait_t_ {
+        const void *Waiter;
+        uint64_t Since;
+        neosmart_stall_t Stall;
+    };
 
-                result = pthread_mutex_unlock(&i->Waiter->Mutex);
-                assert(result == 0);
+    struct neosmart_reported_wait_t_ {
+        uint64_t ThreadId;
+        uint64_t Since;
+    };
 
-                result = pthread_cond_signal(&i->Waiter->CVariable);
-                assert(result == 0);
+    // Only touched by the watchdog thread
+    struct neosmart_watchdog_scan_t_ {
+        neosmart_blocked_wait_t_ Waits[PEVENTS_WATCHDOG_WAITS];
+        int WaitCount;
+        // The stalls reported by the last scan, and those found by this one
+        neosmart_reported_wait_t_ Reported[2][PEVENTS_WATCHDOG_WAITS];
+        int ReportedCount[2];
+    };
 
-                event->RegisteredWaits.pop_front();
+    struct neosmart_watchdog_t_ {
+        pthread_mutex_t Mutex;
+        pthread_cond_t CVariable;
+        pthread_t Thread;
+        bool Running;
+        bool Stopping;
+        uint64_t Threshold;
+        neosmart_stall_callback_t Callback;
+        void *Context;
+        neosmart_watchdog_scan_t_ *Scan;
+        const neosmart_allocator_t *Allocator;
+    };
 
-                result = pthread_mutex_unlock(&event->Mutex);
-                assert(result == 0);
+    PEVENTS_LOCAL neosmart_watchdog_t_ &Watchdog() {
+        static neosmart_watchdog_t_ watchdog = {
+            PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, pthread_t(), false, false, 0, NULL,
+            NULL, NULL, NULL};
+        return watchdog;
+    }
 
-                return 0;
+    // Called with the event's mutex held
+    PEVENTS_LOCAL void AddBlockedWait(neosmart_watchdog_scan_t_ &scan, const void *waiter,
+                                      uint64_t threadId, uint64_t since, neosmart_event_t event,
+                                      bool multiWait, bool waitAll) {
+        int i = 0;
+        while (i < scan.WaitCount && scan.Waits[i].Waiter != waiter) {
+            ++i;
+        }
+        if (i == scan.WaitCount) {
+            if (scan.WaitCount == PEVENTS_WATCHDOG_WAITS) {
+                return;
             }
-#endif // WFMO
-       // event->State can be false if compiled with WFMO support
-            if (event->State) {
-                result = pthread_mutex_unlock(&event->Mutex);
-                assert(result == 0);
-
-                result = pthread_cond_signal(&event->CVariable);
-                assert(result == 0);
+            neosmart_blocked_wait_t_ &wait = scan.Waits[scan.WaitCount++];
+            wait.Waiter = waiter;
+            wait.Since = since;
+            wait.Stall.ThreadId = threadId;
+            wait.Stall.MultiWait = multiWait;
+            wait.Stall.WaitAll = waitAll;
+            wait.Stall.EventCount = 0;
+            wait.Stall.CycleLength = 0;
+        }
+        neosmart_stall_t &stall = scan.Waits[i].Stall;
+        if (stall.EventCount < PEVENTS_STALL_EVENTS) {
+            stall.Events[stall.EventCount] = event;
+            memcpy(stall.Names[stall.EventCount], event->DebugName, PEVENTS_DEBUG_NAME_LENGTH);
+            stall.LastSetters[stall.EventCount] = event->LastSetter.load(std::memory_order_relaxed);
+            ++stall.EventCount;
+        }
+    }
 
-                return 0;
+    // Gathers every wait blocked on a registered event. Named events are left out, as both their
+    // waiters and their setters may be in other processes.
+    PEVENTS_LOCAL void FindBlockedWaits(neosmart_watchdog_scan_t_ &scan) {
+        scan.WaitCount = 0;
+        neosmart_registry_t_ &registry = Registry();
+        int result = pthread_mutex_lock(&registry.Mutex);
+        assert(result == 0);
+        for (neosmart_event_t event = registry.Head; event != NULL; event = event->RegistryNext) {
+#ifdef NAMED
+            if (event->Shared) {
+                continue;
+            }
+#endif
+            // A busy event will be looked at again on the next scan
+            if (pthread_mutex_trylock(&event->Mutex) != 0) {
+                continue;
+            }
+            for (detail::wfso_waiter *wfso = event->WfsoWaiters; wfso != NULL; wfso = wfso->Next) {
+                AddBlockedWait(scan, wfso, wfso->ThreadId, wfso->Since, event, false, false);
             }
-        } else {
 #ifdef WFMO
-            for (size_t i = 0; i < event->RegisteredWaits.size(); ++i) {
-                neosmart_wfmo_info_t info = &event->RegisteredWaits[i];
-
-                result = pthread_mutex_lock(&info->Waiter->Mutex);
+            for (neosmart_wfmo_info_t wait = event->RegisteredWaits.Begin();
+                 wait != event->RegisteredWaits.End(); ++wait) {
+                neosmart_wfmo_t wfmo = wait->Waiter;
+                result = detail::Recover(&wfmo->Mutex, pthread_mutex_lock(&wfmo->Mutex));
                 assert(result == 0);
-
-                --info->Waiter->RefCount;
-                assert(info->Waiter->RefCount >= 0);
-
-                if (!info->Waiter->StillWaiting) {
-                    bool destroy = info->Waiter->RefCount == 0;
-                    result = pthread_mutex_unlock(&info->Waiter->Mutex);
-                    assert(result == 0);
-                    if (destroy) {
-                        info->Waiter->Destroy();
-                        delete info->Waiter;
-                    }
-                    continue;
+                if (wfmo->StillWaiting && !IsStaleWait(*wait)) {
+                    AddBlockedWait(scan, wfmo, wfmo->ThreadId, wfmo->Since, event, true,
+                                   wfmo->WaitAll);
                 }
+                result = pthread_mutex_unlock(&wfmo->Mutex);
+                assert(result == 0);
+            }
+#endif
+            result = pthread_mutex_unlock(&event->Mutex);
+            assert(result == 0);
+        }
+        result = pthread_mutex_unlock(&registry.Mutex);
+        assert(result == 0);
+    }
 
-                if (info->Waiter->WaitAll) {
-                    --info->Waiter->Status.EventsLeft;
-                    assert(info->Waiter->Status.EventsLeft >= 0);
-                    // We technically should do i->Waiter->StillWaiting = Waiter->Status.EventsLeft
-                    // != 0 but the only time it'll be equal to zero is if we're the last event, so
-                    // no one else will be checking the StillWaiting flag. We're good to go without
-                    // it.
-                } else {
-                    info->Waiter->Status.FiredEvent = info->WaitIndex;
-                    info->Waiter->StillWaiting = false;
+    // Extends the path in `stall.Cycle` with the wait at `index`, and follows the threads that
+    // last set its events, looking for one that leads back to `origin`
+    PEVENTS_LOCAL bool FindCycle(const neosmart_watchdog_scan_t_ &scan, int index, uint64_t origin,
+                                 neosmart_stall_t &stall) {
+        if (stall.CycleLength == PEVENTS_STALL_CYCLE) {
+            return false;
+        }
+        const neosmart_stall_t &wait = scan.Waits[index].Stall;
+        stall.Cycle[stall.CycleLength++] = wait.ThreadId;
+        for (int e = 0; e < wait.EventCount; ++e) {
+            uint64_t setter = wait.LastSetters[e];
+            if (setter == origin) {
+                return true;
+            }
+            if (setter == 0 ||
+                std::find(stall.Cycle, stall.Cycle + stall.CycleLength, setter) !=
+                    stall.Cycle + stall.CycleLength) {
+                continue;
+            }
+            for (int next = 0; next < scan.WaitCount; ++next) {
+                if (scan.Waits[next].Stall.ThreadId == setter &&
+                    FindCycle(scan, next, origin, stall)) {
+                    return true;
                 }
+            }
+        }
+        --stall.CycleLength;
+        return false;
+    }
 
-                result = pthread_mutex_unlock(&info->Waiter->Mutex);
-                assert(result == 0);
+    // Reports each wait the first time it's found past the threshold
+    PEVENTS_LOCAL void CheckBlockedWaits(neosmart_watchdog_t_ &watchdog) {
+        neosmart_watchdog_scan_t_ &scan = *watchdog.Scan;
+        FindBlockedWaits(scan);
+
+        uint64_t now = detail::Now();
+        const neosmart_reported_wait_t_ *reported = scan.Reported[0];
+        int reportedCount = scan.ReportedCount[0];
+        neosmart_reported_wait_t_ *stalled = scan.Reported[1];
+        int stalledCount = 0;
+        for (int i = 0; i < scan.WaitCount; ++i) {
+            neosmart_blocked_wait_t_ &wait = scan.Waits[i];
+            if (now < wait.Since || now - wait.Since < watchdog.Threshold) {
+                continue;
+            }
+            neosmart_reported_wait_t_ key = {wait.Stall.ThreadId, wait.Since};
+            stalled[stalledCount++] = key;
+            bool seen = false;
+            for (int j = 0; j < reportedCount && !seen; ++j) {
+                seen = reported[j].ThreadId == key.ThreadId && reported[j].Since == key.Since;
+            }
+            if (seen) {
+                continue;
+            }
 
-                result = pthread_cond_signal(&info->Waiter->CVariable);
-                assert(result == 0);
+            neosmart_stall_t stall = wait.Stall;
+            stall.WaitNanoseconds = now - wait.Since;
+            stall.CycleLength = 0;
+            if (!FindCycle(scan, i, stall.ThreadId, stall)) {
+                stall.CycleLength = 0;
             }
-            event->RegisteredWaits.clear();
-#endif // WFMO
-            result = pthread_mutex_unlock(&event->Mutex);
-            assert(result == 0);
+            watchdog.Callback(&stall, watchdog.Context);
+        }
+        memcpy(scan.Reported[0], stalled, stalledCount * sizeof(stalled[0]));
+        scan.ReportedCount[0] = stalledCount;
+    }
 
-            result = pthread_cond_broadcast(&event->CVariable);
+    PEVENTS_LOCAL void *WatchdogThread(void *) {
+        neosmart_watchdog_t_ &watchdog = Watchdog();
+        // Checking four times per threshold reports a stall at most a quarter late
+        uint64_t interval = std::max<uint64_t>(watchdog.Threshold / 4 / 1000 / 1000, 1);
+        int result = pthread_mutex_lock(&watchdog.Mutex);
+        assert(result == 0);
+        while (!watchdog.Stopping) {
+            timespec ts = detail::Deadline(interval);
+            result = pthread_cond_timedwait(&watchdog.CVariable, &watchdog.Mutex, &ts);
+            if (watchdog.Stopping) {
+                break;
+            }
+            result = pthread_mutex_unlock(&watchdog.Mutex);
+            assert(result == 0);
+            CheckBlockedWaits(watchdog);
+            result = pthread_mutex_lock(&watchdog.Mutex);
             assert(result == 0);
         }
-
-        return 0;
+        result = pthread_mutex_unlock(&watchdog.Mutex);
+        assert(result == 0);
+        return NULL;
     }
 
-    int ResetEvent(neosmart_event_t event) {
-        int result = pthread_mutex_lock(&event->Mutex);
+    PEVENTS_DECL int StartWatchdog(uint64_t thresholdMilliseconds,
+                                   neosmart_stall_callback_t callback, void *context) {
+        neosmart_watchdog_t_ &watchdog = Watchdog();
+        int result = pthread_mutex_lock(&watchdog.Mutex);
         assert(result == 0);
+        if (watchdog.Running) {
+            result = EBUSY;
+        } else {
+            watchdog.Allocator = GetDefaultAllocator();
+            watchdog.Scan = static_cast<neosmart_watchdog_scan_t_ *>(
+                Allocate(watchdog.Allocator, sizeof(neosmart_watchdog_scan_t_),
+                         alignof(neosmart_watchdog_scan_t_)));
+            if (watchdog.Scan == NULL) {
+                result = ENOMEM;
+            } else {
+                watchdog.Scan->ReportedCount[0] = 0;
+                watchdog.Threshold = thresholdMilliseconds * 1000 * 1000;
+                watchdog.Callback = callback;
+                watchdog.Context = context;
+                watchdog.Stopping = false;
+                result = pthread_create(&watchdog.Thread, NULL, WatchdogThread, NULL);
+                if (result == 0) {
+                    watchdog.Running = true;
+                } else {
+                    Deallocate(watchdog.Allocator, watchdog.Scan,
+                               sizeof(neosmart_watchdog_scan_t_),
+                               alignof(neosmart_watchdog_scan_t_));
+                    watchdog.Scan = NULL;
+                }
+            }
+        }
+        int unlocked = pthread_mutex_unlock(&watchdog.Mutex);
+        assert(unlocked == 0);
+        return result;
+    }
 
-        event->State = false;
+    PEVENTS_DECL int StopWatchdog() {
+        neosmart_watchdog_t_ &watchdog = Watchdog();
+        int result = pthread_mutex_lock(&watchdog.Mutex);
+        assert(result == 0);
+        if (!watchdog.Running || watchdog.Stopping) {
+            result = pthread_mutex_unlock(&watchdog.Mutex);
+            assert(result == 0);
+            return ESRCH;
+        }
+        watchdog.Stopping = true;
+        result = pthread_cond_signal(&watchdog.CVariable);
+        assert(result == 0);
+        result = pthread_mutex_unlock(&watchdog.Mutex);
+        assert(result == 0);
 
-        result = pthread_mutex_unlock(&event->Mutex);
+        result = pthread_join(watchdog.Thread, NULL);
         assert(result == 0);
+        Deallocate(watchdog.Allocator, watchdog.Scan, sizeof(neosmart_watchdog_scan_t_),
+                   alignof(neosmart_watchdog_scan_t_));
 
+        result = pthread_mutex_lock(&watchdog.Mutex);
+        assert(result == 0);
+        watchdog.Scan = NULL;
+        watchdog.Running = false;
+        result = pthread_mutex_unlock(&watchdog.Mutex);
+        assert(result == 0);
         return 0;
     }
+#endif
 
 #ifdef PULSE
-    int PulseEvent(neosmart_event_t event) {
+    PEVENTS_DECL int PulseEvent(neosmart_event_t event) {
         // This may look like it's a horribly inefficient kludge with the sole intention of reducing
         // code duplication, but in reality this is what any PulseEvent() implementation must look
         // like. The only overhead (function calls aside, which your compiler will likely optimize
@@ -495,20 +3012,76 @@ namespace neosmart {
 
 #else //_WIN32
 
-#include <Windows.h>
-#include "pevents.h"
+#if defined(STATS) || defined(LATENCY) || defined(TRACE) || defined(CONTENTION)
+#error Event statistics are only available on POSIX platforms
+#endif
+#ifdef REGISTRY
+#error The event registry and watchdog are only available on POSIX platforms
+#endif
+#ifdef ATTRIBUTION
+#error Signaller attribution is only available on POSIX platforms
+#endif
+#ifdef CAPTURE
+#error Workload capture is only available on POSIX platforms
+#endif
+#ifdef USDT
+#error USDT probes are only available on POSIX platforms
+#endif
 
 namespace neosmart {
-    neosmart_event_t CreateEvent(bool manualReset, bool initialState) {
+    PEVENTS_DECL neosmart_event_t CreateEvent(bool manualReset, bool initialState) {
         return static_cast<neosmart_event_t>(::CreateEvent(NULL, manualReset, initialState, NULL));
     }
 
-    int DestroyEvent(neosmart_event_t event) {
+    // Event objects are allocated by the kernel on Windows
+    PEVENTS_DECL neosmart_event_t CreateEvent(bool manualReset, bool initialState,
+                                              const neosmart_allocator_t *) {
+        return CreateEvent(manualReset, initialState);
+    }
+
+#ifdef NAMED
+    PEVENTS_DECL neosmart_event_t CreateEvent(const char *name, bool manualReset,
+                                              bool initialState) {
+        return static_cast<neosmart_event_t>(
+            ::CreateEventA(NULL, manualReset, initialState, name));
+    }
+
+    PEVENTS_DECL neosmart_event_t OpenEvent(const char *name) {
+        return static_cast<neosmart_event_t>(::OpenEventA(EVENT_ALL_ACCESS, FALSE, name));
+    }
+#endif
+
+    PEVENTS_DECL int DestroyEvent(neosmart_event_t event) {
         HANDLE handle = static_cast<HANDLE>(event);
         return CloseHandle(handle) ? 0 : GetLastError();
     }
 
-    int WaitForEvent(neosmart_event_t event, uint64_t milliseconds) {
+    // Kernel event objects can't be laid out by the caller, so on Windows bulk creation is only a
+    // convenience and EVENT_CACHE_ALIGNED has no effect.
+    PEVENTS_DECL int CreateEvents(neosmart_event_t *events, int count, int flags) {
+        for (int i = 0; i < count; ++i) {
+            events[i] = CreateEvent(flags & EVENT_MANUAL_RESET, flags & EVENT_INITIAL_STATE);
+            if (events[i] == NULL) {
+                int error = GetLastError();
+                DestroyEvents(events, i);
+                return error;
+            }
+        }
+        return 0;
+    }
+
+    PEVENTS_DECL int DestroyEvents(neosmart_event_t *events, int count) {
+        int result = 0;
+        for (int i = 0; i < count; ++i) {
+            int error = DestroyEvent(events[i]);
+            if (error != 0) {
+                result = error;
+            }
+        }
+        return result;
+    }
+
+    PEVENTS_DECL int WaitForEvent(neosmart_event_t event, uint64_t milliseconds) {
         uint32_t result = 0;
         HANDLE handle = static_cast<HANDLE>(event);
 
@@ -539,25 +3112,25 @@ namespace neosmart {
         return GetLastError();
     }
 
-    int SetEvent(neosmart_event_t event) {
+    PEVENTS_DECL int SetEvent(neosmart_event_t event) {
         HANDLE handle = static_cast<HANDLE>(event);
         return ::SetEvent(handle) ? 0 : GetLastError();
     }
 
-    int ResetEvent(neosmart_event_t event) {
+    PEVENTS_DECL int ResetEvent(neosmart_event_t event) {
         HANDLE handle = static_cast<HANDLE>(event);
         return ::ResetEvent(handle) ? 0 : GetLastError();
     }
 
 #ifdef WFMO
-    int WaitForMultipleEvents(neosmart_event_t *events, int count, bool waitAll,
-                              uint64_t milliseconds) {
+    PEVENTS_DECL int WaitForMultipleEvents(neosmart_event_t *events, int count, bool waitAll,
+                                           uint64_t milliseconds) {
         int index = 0;
         return WaitForMultipleEvents(events, count, waitAll, milliseconds, index);
     }
 
-    int WaitForMultipleEvents(neosmart_event_t *events, int count, bool waitAll,
-                              uint64_t milliseconds, int &index) {
+    PEVENTS_DECL int WaitForMultipleEvents(neosmart_event_t *events, int count, bool waitAll,
+                                           uint64_t milliseconds, int &index) {
         HANDLE *handles = reinterpret_cast<HANDLE *>(events);
         uint32_t result = 0;
 
@@ -593,7 +3166,7 @@ namespace neosmart {
 #endif
 
 #ifdef PULSE
-    int PulseEvent(neosmart_event_t event) {
+    PEVENTS_DECL int PulseEvent(neosmart_event_t event) {
         HANDLE handle = static_cast<HANDLE>(event);
         return ::PulseEvent(handle) ? 0 : GetLastError();
     }
@@ -601,3 +3174,341 @@ namespace neosmart {
 } // namespace neosmart
 
 #endif //_WIN32
+
+#ifdef HANDLES
+#include <errno.h>
+#include <new>
+
+namespace neosmart {
+    // Handles are split into a table index and the generation of the slot at the time the handle
+    // was issued. Destroying an event bumps its slot's generation, invalidating old handles.
+    // Generation 0 is never issued, so a zero handle is always invalid; slots whose generations
+    // have run out are left at 0 and never reused, so that no stale handle can match them again.
+    // Freed slots are reused oldest first.
+    enum {
+        HANDLE_INDEX_BITS = 20,
+        HANDLE_GENERATION_MASK = (1u << (32 - HANDLE_INDEX_BITS)) - 1,
+        HANDLE_CHUNK_BITS = 10,
+        HANDLE_CHUNK_SIZE = 1 << HANDLE_CHUNK_BITS,
+        HANDLE_CHUNK_COUNT = 1 << (HANDLE_INDEX_BITS - HANDLE_CHUNK_BITS),
+    };
+
+    // Entries' pin counts go up in steps of HANDLE_PIN, leaving the low bit for HANDLE_RETIRED
+    enum { HANDLE_RETIRED = 1, HANDLE_PIN = 2 };
+
+    // Calls made through a handle pin its entry for as long as they use the event, so that a
+    // concurrent DestroyEvent() only retires the event: the last call to unpin it destroys it and
+    // frees the entry for reuse.
+    struct neosmart_handle_entry_t_ {
+        std::atomic<neosmart_event_t> Event;
+        std::atomic<uint32_t> Generation;
+        std::atomic<uint32_t> Pins;
+        // The event of a destroyed handle, until it's no longer pinned
+        neosmart_event_t Retired;
+        uint32_t Index;
+        uint32_t NextFree;
+    };
+
+    // Lookups only ever read the chunk directory and the entries, so they need no locking; the
+    // mutex serializes handle creation and destruction, and the free list.
+    struct neosmart_handle_table_t_ {
+#ifdef _WIN32
+        SRWLOCK Mutex;
+#else
+        pthread_mutex_t Mutex;
+#endif
+        std::atomic<neosmart_handle_entry_t_ *> Chunks[HANDLE_CHUNK_COUNT];
+        uint32_t FreeHead;
+        uint32_t FreeTail;
+        uint32_t Allocated;
+    };
+
+    PEVENTS_LOCAL neosmart_handle_table_t_ &HandleTable() {
+#ifdef _WIN32
+        static neosmart_handle_table_t_ table = {SRWLOCK_INIT, {}, UINT32_MAX, UINT32_MAX, 0};
+#else
+        static neosmart_handle_table_t_ table = {PTHREAD_MUTEX_INITIALIZER, {}, UINT32_MAX,
+                                                 UINT32_MAX, 0};
+#endif
+        return table;
+    }
+
+    PEVENTS_LOCAL void LockHandleTable(neosmart_handle_table_t_ &table) {
+#ifdef _WIN32
+        AcquireSRWLockExclusive(&table.Mutex);
+#else
+        int result = pthread_mutex_lock(&table.Mutex);
+        assert(result == 0);
+#endif
+    }
+
+    PEVENTS_LOCAL void UnlockHandleTable(neosmart_handle_table_t_ &table) {
+#ifdef _WIN32
+        ReleaseSRWLockExclusive(&table.Mutex);
+#else
+        int result = pthread_mutex_unlock(&table.Mutex);
+        assert(result == 0);
+#endif
+    }
+
+    PEVENTS_LOCAL neosmart_handle_entry_t_ *HandleEntry(uint32_t index) {
+        neosmart_handle_entry_t_ *chunk =
+            HandleTable().Chunks[index >> HANDLE_CHUNK_BITS].load(std::memory_order_acquire);
+        return chunk == NULL ? NULL : &chunk[index & (HANDLE_CHUNK_SIZE - 1)];
+    }
+
+    PEVENTS_LOCAL uint32_t HandleIndex(neosmart_handle_t handle) {
+        return handle.Value & ((1u << HANDLE_INDEX_BITS) - 1);
+    }
+
+    PEVENTS_LOCAL uint32_t HandleGeneration(neosmart_handle_t handle) {
+        return handle.Value >> HANDLE_INDEX_BITS;
+    }
+
+    // Called with the table mutex held
+    PEVENTS_LOCAL void FreeHandleEntry(neosmart_handle_table_t_ &table,
+                                       neosmart_handle_entry_t_ *entry) {
+        if (entry->Generation.load(std::memory_order_relaxed) == 0) {
+            return;
+        }
+        entry->NextFree = UINT32_MAX;
+        if (table.FreeTail == UINT32_MAX) {
+            table.FreeHead = entry->Index;
+        } else {
+            HandleEntry(table.FreeTail)->NextFree = entry->Index;
+        }
+        table.FreeTail = entry->Index;
+    }
+
+    PEVENTS_DECL neosmart_event_t ResolveHandle(neosmart_handle_t handle) {
+        neosmart_handle_entry_t_ *entry = HandleEntry(HandleIndex(handle));
+        uint32_t generation = HandleGeneration(handle);
+        if (entry == NULL || entry->Generation.load(std::memory_order_acquire) != generation) {
+            return NULL;
+        }
+        neosmart_event_t event = entry->Event.load(std::memory_order_acquire);
+        // Should the handle have been destroyed and its entry reused since the first check, the
+        // event loaded is another handle's
+        if (entry->Generation.load(std::memory_order_acquire) != generation) {
+            return NULL;
+        }
+        return event;
+    }
+
+    // Destroys a retired event and frees its entry, unless it's pinned (in which case the call
+    // that unpins it last does so)
+    PEVENTS_LOCAL int ReleaseRetired(neosmart_handle_entry_t_ *entry) {
+        uint32_t retired = HANDLE_RETIRED;
+        if (!entry->Pins.compare_exchange_strong(retired, 0)) {
+            return 0;
+        }
+        int result = DestroyEvent(entry->Retired);
+        entry->Retired = NULL;
+
+        neosmart_handle_table_t_ &table = HandleTable();
+        LockHandleTable(table);
+        FreeHandleEntry(table, entry);
+        UnlockHandleTable(table);
+        return result;
+    }
+
+    PEVENTS_LOCAL void UnpinHandle(neosmart_handle_entry_t_ *entry) {
+        if (entry->Pins.fetch_sub(HANDLE_PIN) == HANDLE_PIN + HANDLE_RETIRED) {
+            ReleaseRetired(entry);
+        }
+    }
+
+    // Resolves a handle, keeping its event from being destroyed until UnpinHandle(entry)
+    PEVENTS_LOCAL neosmart_event_t PinHandle(neosmart_handle_t handle,
+                                             neosmart_handle_entry_t_ *&entry) {
+        entry = HandleEntry(HandleIndex(handle));
+        if (entry == NULL) {
+            return NULL;
+        }
+        // The generation is checked once pinned: a DestroyEvent() bumping it either is seen here,
+        // or sees the pin and leaves the event for UnpinHandle() to destroy. Either way the entry
+        // can't be reused while pinned.
+        entry->Pins.fetch_add(HANDLE_PIN);
+        neosmart_event_t event = NULL;
+        if (entry->Generation.load() == HandleGeneration(handle)) {
+            event = entry->Event.load(std::memory_order_acquire);
+        }
+        if (event == NULL) {
+            UnpinHandle(entry);
+        }
+        return event;
+    }
+
+    PEVENTS_DECL neosmart_handle_t CreateEventHandle(bool manualReset, bool initialState) {
+        neosmart_handle_t handle = {0};
+        neosmart_handle_table_t_ &table = HandleTable();
+        LockHandleTable(table);
+
+        uint32_t index = table.FreeHead;
+        if (index != UINT32_MAX) {
+            table.FreeHead = HandleEntry(index)->NextFree;
+            if (table.FreeHead == UINT32_MAX) {
+                table.FreeTail = UINT32_MAX;
+            }
+        } else {
+            if (table.Allocated == HANDLE_CHUNK_SIZE * HANDLE_CHUNK_COUNT) {
+                UnlockHandleTable(table);
+                return handle;
+            }
+            index = table.Allocated++;
+            if ((index & (HANDLE_CHUNK_SIZE - 1)) == 0) {
+                size_t size = sizeof(neosmart_handle_entry_t_) * HANDLE_CHUNK_SIZE;
+                neosmart_handle_entry_t_ *chunk = static_cast<neosmart_handle_entry_t_ *>(
+                    Allocate(GetDefaultAllocator(), size, alignof(neosmart_handle_entry_t_)));
+                if (chunk == NULL) {
+                    --table.Allocated;
+                    UnlockHandleTable(table);
+                    return handle;
+                }
+                for (int i = 0; i < HANDLE_CHUNK_SIZE; ++i) {
+                    new (&chunk[i]) neosmart_handle_entry_t_;
+                    chunk[i].Event.store(NULL, std::memory_order_relaxed);
+                    chunk[i].Generation.store(1, std::memory_order_relaxed);
+                    chunk[i].Pins.store(0, std::memory_order_relaxed);
+                    chunk[i].Retired = NULL;
+                    chunk[i].Index = index + i;
+                }
+                table.Chunks[index >> HANDLE_CHUNK_BITS].store(chunk, std::memory_order_release);
+            }
+        }
+
+        neosmart_handle_entry_t_ *entry = HandleEntry(index);
+        neosmart_event_t event = CreateEvent(manualReset, initialState);
+        if (event == NULL) {
+            FreeHandleEntry(table, entry);
+            UnlockHandleTable(table);
+            return handle;
+        }
+        entry->Event.store(event, std::memory_order_release);
+        uint32_t generation = entry->Generation.load(std::memory_order_relaxed);
+        UnlockHandleTable(table);
+
+        handle.Value = (generation << HANDLE_INDEX_BITS) | index;
+        return handle;
+    }
+
+    // Returns once the handle is invalidated. Should other threads still be using the event (say,
+    // blocked waiting on it), it's destroyed once the last of them is done with it.
+    PEVENTS_DECL int DestroyEvent(neosmart_handle_t handle) {
+        neosmart_handle_table_t_ &table = HandleTable();
+        LockHandleTable(table);
+
+        uint32_t generation = HandleGeneration(handle);
+        neosmart_handle_entry_t_ *entry = HandleEntry(HandleIndex(handle));
+        if (entry == NULL || entry->Generation.load(std::memory_order_relaxed) != generation ||
+            entry->Event.load(std::memory_order_relaxed) == NULL) {
+            UnlockHandleTable(table);
+            return EBADF;
+        }
+
+        entry->Retired = entry->Event.load(std::memory_order_relaxed);
+        entry->Event.store(NULL, std::memory_order_relaxed);
+        entry->Generation.store(generation < HANDLE_GENERATION_MASK ? generation + 1 : 0);
+        UnlockHandleTable(table);
+
+        if (entry->Pins.fetch_or(HANDLE_RETIRED) == 0) {
+            return ReleaseRetired(entry);
+        }
+        return 0;
+    }
+
+    PEVENTS_DECL int WaitForEvent(neosmart_handle_t handle, uint64_t milliseconds) {
+        neosmart_handle_entry_t_ *entry;
+        neosmart_event_t event = PinHandle(handle, entry);
+        if (event == NULL) {
+            return EBADF;
+        }
+        int result = WaitForEvent(event, milliseconds);
+        UnpinHandle(entry);
+        return result;
+    }
+
+    PEVENTS_DECL int SetEvent(neosmart_handle_t handle) {
+        neosmart_handle_entry_t_ *entry;
+        neosmart_event_t event = PinHandle(handle, entry);
+        if (event == NULL) {
+            return EBADF;
+        }
+        int result = SetEvent(event);
+        UnpinHandle(entry);
+        return result;
+    }
+
+    PEVENTS_DECL int ResetEvent(neosmart_handle_t handle) {
+        neosmart_handle_entry_t_ *entry;
+        neosmart_event_t event = PinHandle(handle, entry);
+        if (event == NULL) {
+            return EBADF;
+        }
+        int result = ResetEvent(event);
+        UnpinHandle(entry);
+        return result;
+    }
+
+#ifndef _WIN32
+    PEVENTS_DECL bool IsEventSet(neosmart_handle_t handle) {
+        neosmart_handle_entry_t_ *entry;
+        neosmart_event_t event = PinHandle(handle, entry);
+        if (event == NULL) {
+            return false;
+        }
+        bool set = IsEventSet(event);
+        UnpinHandle(entry);
+        return set;
+    }
+#endif
+
+#ifdef WFMO
+    PEVENTS_DECL int WaitForMultipleEvents(const neosmart_handle_t *handles, int count,
+                                           bool waitAll, uint64_t milliseconds) {
+        int unused;
+        return WaitForMultipleEvents(handles, count, waitAll, milliseconds, unused);
+    }
+
+    PEVENTS_DECL int WaitForMultipleEvents(const neosmart_handle_t *handles, int count,
+                                           bool waitAll, uint64_t milliseconds, int &index) {
+        neosmart_event_t localEvents[64];
+        neosmart_handle_entry_t_ *localEntries[64];
+        neosmart_event_t *events = localEvents;
+        neosmart_handle_entry_t_ **entries = localEntries;
+        const neosmart_allocator_t *allocator = GetDefaultAllocator();
+        size_t size = (sizeof(neosmart_event_t) + sizeof(neosmart_handle_entry_t_ *)) * count;
+        if (count > 64) {
+            char *memory = static_cast<char *>(Allocate(allocator, size, alignof(void *)));
+            if (memory == NULL) {
+                return ENOMEM;
+            }
+            events = reinterpret_cast<neosmart_event_t *>(memory);
+            entries = reinterpret_cast<neosmart_handle_entry_t_ **>(
+                memory + sizeof(neosmart_event_t) * count);
+        }
+
+        int result = 0;
+        int pinned = 0;
+        for (; pinned < count; ++pinned) {
+            events[pinned] = PinHandle(handles[pinned], entries[pinned]);
+            if (events[pinned] == NULL) {
+                result = EBADF;
+                break;
+            }
+        }
+
+        if (result == 0) {
+            result = WaitForMultipleEvents(events, count, waitAll, milliseconds, index);
+        }
+        for (int i = 0; i < pinned; ++i) {
+            UnpinHandle(entries[i]);
+        }
+        if (events != localEvents) {
+            Deallocate(allocator, events, size, alignof(void *));
+        }
+        return result;
+    }
+#endif
+} // namespace neosmart
+#endif // HANDLES
@@ -15,19 +15,88 @@
 #define WAIT_TIMEOUT ETIMEDOUT
 #endif
 
+#include <stddef.h>
 #include <stdint.h>
+#if defined(__has_include) && __cplusplus >= 201703L
+#if __has_include(<memory_resource>)
+#include <memory_resource>
+#define PEVENTS_HAS_PMR
+#endif
+#endif
+
+// With PEVENTS_HEADER_ONLY defined, pevents.cpp is compiled as part of every file including this
+// header rather than as a library of its own, which lets callers inline the fast paths.
+#ifdef PEVENTS_HEADER_ONLY
+#define PEVENTS_DECL inline
+#define PEVENTS_LOCAL inline
+#else
+#define PEVENTS_DECL
+#define PEVENTS_LOCAL static
+#endif
+// Marks slow paths, keeping them out of line and out of the way of the fast paths calling them
+#ifdef __GNUC__
+#define PEVENTS_COLD __attribute__((cold))
+#else
+#define PEVENTS_COLD
+#endif
+
+#ifndef PEVENTS_CACHE_LINE
+#define PEVENTS_CACHE_LINE 64
+#endif
+
+// The watchdog finds blocked waits through the registry of live events
+#if defined(WATCHDOG) && !defined(REGISTRY)
+#define REGISTRY
+#endif
 
 namespace neosmart {
     // Type declarations
     struct neosmart_event_t_;
     typedef neosmart_event_t_ *neosmart_event_t;
 
+    // Hooks through which pevents makes all of its allocations
+    struct neosmart_allocator_t {
+        void *(*Allocate)(size_t size, size_t alignment, void *context);
+        void (*Deallocate)(void *memory, size_t size, size_t alignment, void *context);
+        void *Context;
+    };
+
+    // Flags for CreateEvents()
+    enum {
+        EVENT_MANUAL_RESET = 1,
+        EVENT_INITIAL_STATE = 2,
+        // Give each event its own cache line(s), so that hot events don't false-share
+        EVENT_CACHE_ALIGNED = 4,
+    };
+
     // Function declarations
     neosmart_event_t CreateEvent(bool manualReset = false, bool initialState = false);
+    // Creates an event whose memory (and internal allocations) come from `allocator`, which must
+    // outlive the event
+    neosmart_event_t CreateEvent(bool manualReset, bool initialState,
+                                 const neosmart_allocator_t *allocator);
     int DestroyEvent(neosmart_event_t event);
     int WaitForEvent(neosmart_event_t event, uint64_t milliseconds = -1ul);
     int SetEvent(neosmart_event_t event);
     int ResetEvent(neosmart_event_t event);
+#ifndef _WIN32
+    // Whether the event is currently set, as a single atomic load: it neither takes the event's
+    // lock nor consumes an auto-reset event. (Windows has no way to query an auto-reset event
+    // without consuming it, so there's no equivalent there.)
+    bool IsEventSet(neosmart_event_t event);
+#endif
+    // Creates `count` events in one contiguous allocation. They must be destroyed together, by
+    // passing the same array (in any order) to DestroyEvents(), which fails with EINVAL otherwise,
+    // and never individually with DestroyEvent().
+    int CreateEvents(neosmart_event_t *events, int count, int flags = 0);
+    int DestroyEvents(neosmart_event_t *events, int count);
+#ifdef NAMED
+    // Named events are shared by every process that creates or opens the same name. Creating an
+    // event that already exists opens it, ignoring `manualReset` and `initialState`.
+    neosmart_event_t CreateEvent(const char *name, bool manualReset = false,
+                                 bool initialState = false);
+    neosmart_event_t OpenEvent(const char *name);
+#endif
 #ifdef WFMO
     int WaitForMultipleEvents(neosmart_event_t *events, int count, bool waitAll,
                               uint64_t milliseconds);
@@ -36,5 +105,274 @@ namespace neosmart {
 #endif
 #ifdef PULSE
     int PulseEvent(neosmart_event_t event);
+#endif
+
+    // Sets the allocator used for events created without one, as well as for internal bookkeeping
+    // not tied to a single event. Passing NULL restores the default heap allocator.
+    void SetDefaultAllocator(const neosmart_allocator_t *allocator);
+    const neosmart_allocator_t *GetDefaultAllocator();
+
+#ifdef PEVENTS_HAS_PMR
+    // Wraps a std::pmr::memory_resource as a pevents allocator
+    inline neosmart_allocator_t MakeAllocator(std::pmr::memory_resource *resource) {
+        neosmart_allocator_t allocator;
+        allocator.Allocate = [](size_t size, size_t alignment, void *context) -> void * {
+            try {
+                return static_cast<std::pmr::memory_resource *>(context)->allocate(size, alignment);
+            } catch (...) {
+                return nullptr;
+            }
+        };
+        allocator.Deallocate = [](void *memory, size_t size, size_t alignment, void *context) {
+            static_cast<std::pmr::memory_resource *>(context)->deallocate(memory, size, alignment);
+        };
+        allocator.Context = resource;
+        return allocator;
+    }
+#endif
+
+#ifdef NUMA
+    enum { NUMA_LOCAL_NODE = -1 };
+
+    // Returns an allocator that places memory on the given NUMA node, or on the node of the
+    // allocating thread for NUMA_LOCAL_NODE. Pass it to CreateEvent() or SetDefaultAllocator().
+    const neosmart_allocator_t *GetNumaAllocator(int node = NUMA_LOCAL_NODE);
+    // The NUMA node the calling thread is currently running on
+    int GetCurrentNumaNode();
+#endif
+
+#ifdef STATS
+    // A snapshot of the counters kept when built with STATS, for one event or (summed over every
+    // event) for the whole process. Counters are updated with relaxed atomics, so a snapshot taken
+    // while events are in use is approximate.
+    struct neosmart_event_stats_t {
+        uint64_t Sets;
+        // Sets of an event that was already set
+        uint64_t RedundantSets;
+        uint64_t Resets;
+        // Successful and timed-out WaitForEvent() calls
+        uint64_t Waits;
+        uint64_t Timeouts;
+        // Wakeups in WaitForEvent() that found the event still (or again) unset
+        uint64_t SpuriousWakeups;
+        // WaitForMultipleEvents() waits that had to be registered with the event
+        uint64_t WfmoRegistrations;
+        // Registrations left behind by WFMO calls that had since returned, and cleaned up
+        uint64_t ExpiredWaitsRemoved;
+        // The most threads ever waiting on the event at once (for the process: on any one event)
+        uint64_t PeakWaiters;
+    };
+
+    int GetEventStats(neosmart_event_t event, neosmart_event_stats_t *stats);
+    void GetGlobalEventStats(neosmart_event_stats_t *stats);
+#endif
+
+#ifdef LATENCY
+    // Wake latencies - the time from the SetEvent() that woke a blocked wait to the waiter running
+    // again - are kept in nanoseconds, in log-linear buckets: values below 8 have one bucket each,
+    // and every power of two above that is split into 8 buckets (so each bucket is within 12.5% of
+    // the values it holds), up to 2^40 ns. Larger values land in the last bucket.
+    enum { LATENCY_BUCKETS = 304 };
+
+    struct neosmart_latency_stats_t {
+        uint64_t Count;
+        uint64_t Sum;
+        uint64_t Min;
+        uint64_t Max;
+        uint64_t Buckets[LATENCY_BUCKETS];
+    };
+
+    // The wake latency of the calling thread's last WaitForEvent() or WaitForMultipleEvents(), if
+    // it blocked and was woken by an event, or 0 otherwise
+    uint64_t GetLastWakeLatency();
+    // The latencies of every wait on `event` that was woken by it
+    int GetEventLatencies(neosmart_event_t event, neosmart_latency_stats_t *stats);
+    // The smallest value of the given bucket
+    uint64_t LatencyBucketBase(int bucket);
+    // The (bucket-precision) latency below which `percentile` percent of samples fall
+    uint64_t LatencyPercentile(const neosmart_latency_stats_t *stats, double percentile);
+#endif
+
+#ifdef TRACE
+    // Writes the calls recorded by every thread (the last PEVENTS_TRACE_RECORDS of each) to `path`
+    // as Chrome trace event JSON, for chrome://tracing or ui.perfetto.dev. Sets are linked to the
+    // waits they woke with flow arrows. Returns 0 or an errno value.
+    int WriteEventTrace(const char *path);
+#endif
+
+    // The operations pevents takes its internal locks for, as reported with CONTENTION
+    enum {
+        LOCK_OP_SET,
+        LOCK_OP_RESET,
+        LOCK_OP_WAIT,
+        // Registering a WaitForMultipleEvents() with each of its events
+        LOCK_OP_REGISTER,
+        // Cleaning up after a WaitForMultipleEvents() that has already returned
+        LOCK_OP_CLEANUP,
+        LOCK_OPS,
+    };
+
+#ifdef CONTENTION
+    struct neosmart_lock_stats_t {
+        // Acquisitions and hold times are only measured once a lock has been found contended
+        uint64_t Acquisitions;
+        uint64_t HoldNanoseconds;
+        // Acquisitions that had to wait for the lock, and for how long
+        uint64_t Contended;
+        uint64_t WaitNanoseconds;
+        uint64_t MaxWaitNanoseconds;
+    };
+
+    struct neosmart_event_contention_t {
+        // The address of the event, which may since have been destroyed
+        const void *Event;
+        bool Destroyed;
+        // Summed over all operations
+        uint64_t WaitNanoseconds;
+        neosmart_lock_stats_t Ops[LOCK_OPS];
+    };
+
+    // Contention on the mutex of a single event. Returns ENOENT if it has never been contended.
+    int GetEventContention(neosmart_event_t event, neosmart_event_contention_t *contention);
+    // Fills `events` with up to `count` of the events whose mutexes have been waited on the
+    // longest, most contended first, and returns how many were filled in
+    int GetContendedEvents(neosmart_event_contention_t *events, int count);
+    // Contention on the mutexes of WaitForMultipleEvents() calls, which are shared by all the
+    // events they wait on, indexed by LOCK_OP_*
+    void GetWaiterContention(neosmart_lock_stats_t *stats);
+#endif
+
+#ifdef ATTRIBUTION
+    // The SetEvent() that a wait returned on
+    struct neosmart_wake_t {
+        // Of the event that ended the wait, into the events waited on
+        int Index;
+        // The thread that set the event, when (in nanoseconds on the monotonic clock), and the
+        // tag it passed; all zero unless the event was set with SetEventEx()
+        uint64_t SetterThreadId;
+        uint64_t SetNanoseconds;
+        uint64_t Tag;
+    };
+
+    // SetEvent(), telling whoever it wakes who set the event, when, and with what `tag`
+    int SetEventEx(neosmart_event_t event, uint64_t tag);
+    // As WaitForEvent() and WaitForMultipleEvents(), describing in `wake` the set the wait returned
+    // on (if it returned 0). For a wait-all, that's the set that completed it.
+    int WaitForEventEx(neosmart_event_t event, uint64_t milliseconds, neosmart_wake_t *wake);
+#ifdef WFMO
+    int WaitForMultipleEventsEx(neosmart_event_t *events, int count, bool waitAll,
+                                uint64_t milliseconds, neosmart_wake_t *wake);
+#endif
+#endif
+
+#ifdef REGISTRY
+#ifndef PEVENTS_DEBUG_NAME_LENGTH
+#define PEVENTS_DEBUG_NAME_LENGTH 32
+#endif
+    // Events created with CreateEvent(), CreateEvents() or OpenEvent() are kept in a registry of
+    // live events until destroyed; other events (such as static ones) join it once named.
+    struct neosmart_event_info_t {
+        neosmart_event_t Event;
+        char Name[PEVENTS_DEBUG_NAME_LENGTH];
+        bool ManualReset;
+        bool State;
+        bool Named;
+        // Threads blocked in WaitForEvent() and pending WaitForMultipleEvents() calls, or -1 if
+        // they couldn't be counted: the event was busy, or (for WFSO waiters of a named event)
+        // they may be in another process
+        int Waiters;
+        int MultiWaiters;
+    };
+
+    // Gives the event a name (truncated to PEVENTS_DEBUG_NAME_LENGTH - 1 characters) to be listed
+    // under, adding it to the registry if it isn't already there
+    int SetEventName(neosmart_event_t event, const char *name);
+    // Fills `events` with up to `count` live events, and returns how many there are in all
+    int ListEvents(neosmart_event_info_t *events, int count);
+    // Writes a human-readable list of live events and their waiters to the file descriptor `fd`
+    int DumpEvents(int fd);
+    // Makes `signal` (e.g. SIGUSR1) dump the registry to `fd`, from a thread started for the
+    // purpose; the signal handler itself only wakes that thread
+    int EnableEventDumpSignal(int signal, int fd);
+#endif
+
+#ifdef WATCHDOG
+#ifndef PEVENTS_STALL_EVENTS
+#define PEVENTS_STALL_EVENTS 8
+#endif
+#ifndef PEVENTS_STALL_CYCLE
+#define PEVENTS_STALL_CYCLE 8
+#endif
+    // A wait on registered events that has gone on for longer than the watchdog's threshold
+    struct neosmart_stall_t {
+        uint64_t ThreadId;
+        uint64_t WaitNanoseconds;
+        // Whether this is a WaitForMultipleEvents() call, and if so, whether it waits for all
+        bool MultiWait;
+        bool WaitAll;
+        // The first PEVENTS_STALL_EVENTS events the wait is registered with, with their debug
+        // names and the thread that last set each (0 if it never has been)
+        int EventCount;
+        neosmart_event_t Events[PEVENTS_STALL_EVENTS];
+        char Names[PEVENTS_STALL_EVENTS][PEVENTS_DEBUG_NAME_LENGTH];
+        uint64_t LastSetters[PEVENTS_STALL_EVENTS];
+        // A wait-for cycle through this wait, if one was found: Cycle[0] is this thread, each
+        // following thread last set an event the one before it is blocked on, and the last of
+        // them is blocked on an event this thread last set. A thread blocked on an event it set
+        // itself forms a cycle of one.
+        int CycleLength;
+        uint64_t Cycle[PEVENTS_STALL_CYCLE];
+    };
+    typedef void (*neosmart_stall_callback_t)(const neosmart_stall_t *stall, void *context);
+
+    // Starts a thread that checks on blocked waits several times per `thresholdMilliseconds`, and
+    // calls `callback` (from that thread) once for each wait that runs past the threshold
+    int StartWatchdog(uint64_t thresholdMilliseconds, neosmart_stall_callback_t callback,
+                      void *context);
+    int StopWatchdog();
+#endif
+
+#ifdef HANDLES
+    // Compact 32-bit event handles, resolved through a global table. A handle that has been passed
+    // to DestroyEvent() is detected and rejected with EBADF rather than being dereferenced. Events
+    // destroyed while calls through their handle are still using them are destroyed once the last
+    // of those calls returns.
+    //
+    // Each of the table's 2^20 slots issues up to 4095 handles, and is then never used again, so
+    // that a stale handle can't alias a later one. CreateEventHandle() returns a zero handle once
+    // every slot is used up, after some 4 billion handles.
+    struct neosmart_handle_t {
+        uint32_t Value;
+    };
+
+    neosmart_handle_t CreateEventHandle(bool manualReset = false, bool initialState = false);
+    int DestroyEvent(neosmart_handle_t handle);
+    int WaitForEvent(neosmart_handle_t handle, uint64_t milliseconds = -1ul);
+    int SetEvent(neosmart_handle_t handle);
+    int ResetEvent(neosmart_handle_t handle);
+#ifndef _WIN32
+    // False for stale handles
+    bool IsEventSet(neosmart_handle_t handle);
+#endif
+    // Returns the underlying event, or NULL if the handle is stale. Unlike calls made through the
+    // handle, nothing keeps the event from being destroyed by a concurrent DestroyEvent().
+    neosmart_event_t ResolveHandle(neosmart_handle_t handle);
+#ifdef WFMO
+    int WaitForMultipleEvents(const neosmart_handle_t *handles, int count, bool waitAll,
+                              uint64_t milliseconds);
+    int WaitForMultipleEvents(const neosmart_handle_t *handles, int count, bool waitAll,
+                              uint64_t milliseconds, int &index);
+#endif
 #endif
 } // namespace neosmart
+
+// basic_event.h starts by including this file, and takes care of the rest itself
+#ifndef PEVENTS_INCLUDING_BASIC_EVENT
+#ifndef _WIN32
+// For neosmart_event_t_, which can be declared directly as a static event
+#include "basic_event.h"
+#endif
+#ifdef PEVENTS_HEADER_ONLY
+#include "pevents.cpp"
+#endif
+#endif
@@ -0,0 +1,128 @@
+// Test that with a custom allocator installed, pevents makes no allocations of its own through the
+// global operator new or malloc-backed default allocator, including those made for diagnostics.
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+#include <errno.h>
+#include <iostream>
+#include <new>
+#include <pevents.h>
+#include <stdlib.h>
+#ifdef CAPTURE
+#include <pcapture.h>
+#include <stdio.h>
+#include <unistd.h>
+#endif
+
+using namespace neosmart;
+
+static size_t globalAllocations = 0;
+
+void *operator new(size_t size) {
+    ++globalAllocations;
+    void *memory = malloc(size);
+    if (memory == nullptr) {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+
+void operator delete(void *memory) noexcept {
+    free(memory);
+}
+
+void operator delete(void *memory, size_t) noexcept {
+    free(memory);
+}
+
+#ifdef __linux__
+// The default heap allocator is backed by posix_memalign(), which is counted too
+extern "C" int posix_memalign(void **memory, size_t alignment, size_t size) noexcept {
+    ++globalAllocations;
+    *memory = aligned_alloc(alignment, (size + alignment - 1) & ~(alignment - 1));
+    return *memory != nullptr ? 0 : ENOMEM;
+}
+#endif
+
+struct CountingArena {
+    size_t Allocations = 0;
+    size_t Outstanding = 0;
+};
+
+void *ArenaAllocate(size_t size, size_t alignment, void *context) {
+    auto arena = static_cast<CountingArena *>(context);
+    ++arena->Allocations;
+    ++arena->Outstanding;
+    // Hand out extra-aligned memory so that alignment requests are honored
+    return aligned_alloc(alignment < 64 ? 64 : alignment, (size + 63) & ~size_t(63));
+}
+
+void ArenaDeallocate(void *memory, size_t, size_t, void *context) {
+    --static_cast<CountingArena *>(context)->Outstanding;
+    free(memory);
+}
+
+int main() {
+    CountingArena globalArena, eventArena;
+    neosmart_allocator_t global = {ArenaAllocate, ArenaDeallocate, &globalArena};
+    neosmart_allocator_t perEvent = {ArenaAllocate, ArenaDeallocate, &eventArena};
+
+    SetDefaultAllocator(&global);
+    size_t before = globalAllocations;
+
+    neosmart_event_t events[4];
+    events[0] = CreateEvent(false, false);
+    events[1] = CreateEvent(true, false, &perEvent);
+    CreateEvents(events + 2, 2, EVENT_CACHE_ALIGNED);
+
+    SetEvent(events[1]);
+    WaitForEvent(events[1], 0);
+    ResetEvent(events[1]);
+#ifdef WFMO
+    // Registers waits with every event, which then have to be tracked and cleaned up
+    for (int i = 0; i < 10; ++i) {
+        WaitForMultipleEvents(events, 4, false, 1);
+    }
+    SetEvent(events[3]);
+    WaitForMultipleEvents(events, 4, false, 0);
+#endif
+#ifdef WATCHDOG
+    StartWatchdog(1000, [](const neosmart_stall_t *, void *) {}, nullptr);
+    StopWatchdog();
+#endif
+    // Trace rings and capture buffers are kept for the rest of the process
+    size_t kept = 0;
+#ifdef TRACE
+    ++kept;
+#endif
+#ifdef CAPTURE
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/pevents-allocator-%d.bin", (int)getpid());
+    StartCapture(path);
+    SetEvent(events[0]);
+    StopCapture();
+    unlink(path);
+    ++kept;
+#endif
+
+    DestroyEvent(events[0]);
+    DestroyEvent(events[1]);
+    DestroyEvents(events + 2, 2);
+
+    if (globalAllocations != before) {
+        std::cout << globalAllocations - before << " allocations escaped the allocator!"
+                  << std::endl;
+        return 1;
+    }
+    if (globalArena.Allocations == 0 || eventArena.Allocations == 0) {
+        std::cout << "Custom allocators were not used!" << std::endl;
+        return 1;
+    }
+    if (globalArena.Outstanding != kept || eventArena.Outstanding != 0) {
+        std::cout << "Memory from custom allocators was leaked!" << std::endl;
+        return 1;
+    }
+
+    SetDefaultAllocator(nullptr);
+    return 0;
+}
@@ -0,0 +1,100 @@
+// Test that events created in bulk are laid out contiguously (and cache-line aligned when asked)
+// and otherwise behave like individually created events, and that they're destroyed as a block
+// however their array is reordered.
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+#include <algorithm>
+#include <errno.h>
+#include <iostream>
+#include <pevents.h>
+#include <stdint.h>
+
+using namespace neosmart;
+
+int main() {
+    const int count = 256;
+    neosmart_event_t events[count];
+
+    if (CreateEvents(events, count, EVENT_MANUAL_RESET | EVENT_CACHE_ALIGNED) != 0) {
+        std::cout << "CreateEvents() failed!" << std::endl;
+        return 1;
+    }
+
+#ifndef _WIN32
+    uintptr_t stride = (uintptr_t)events[1] - (uintptr_t)events[0];
+    for (int i = 0; i < count; ++i) {
+        if ((uintptr_t)events[i] % PEVENTS_CACHE_LINE != 0 ||
+            (uintptr_t)events[i] != (uintptr_t)events[0] + stride * i) {
+            std::cout << "Event " << i << " is not cache-aligned and contiguous!" << std::endl;
+            return 1;
+        }
+    }
+#endif
+
+    for (int i = 0; i < count; ++i) {
+        if (WaitForEvent(events[i], 0) != WAIT_TIMEOUT) {
+            std::cout << "Event " << i << " was created signalled!" << std::endl;
+            return 1;
+        }
+    }
+
+    SetEvent(events[200]);
+    // Manual-reset: still set after being waited on
+    if (WaitForEvent(events[200], 0) != 0 || WaitForEvent(events[200], 0) != 0) {
+        std::cout << "Bulk-created manual-reset event misbehaved!" << std::endl;
+        return 1;
+    }
+
+#ifdef WFMO
+    int index = -1;
+    if (WaitForMultipleEvents(events, count, false, 0, index) != 0 || index != 200) {
+        std::cout << "WFMO over bulk-created events returned the wrong index!" << std::endl;
+        return 1;
+    }
+#endif
+
+    DestroyEvents(events, count);
+
+    // Auto-reset, initially set, unpadded
+    if (CreateEvents(events, count, EVENT_INITIAL_STATE) != 0) {
+        std::cout << "CreateEvents() failed!" << std::endl;
+        return 1;
+    }
+    for (int i = 0; i < count; ++i) {
+        if (WaitForEvent(events[i], 0) != 0 || WaitForEvent(events[i], 0) != WAIT_TIMEOUT) {
+            std::cout << "Bulk-created auto-reset event " << i << " misbehaved!" << std::endl;
+            return 1;
+        }
+    }
+
+    // Destroyed however the array was reordered, but only ever as a whole
+    std::reverse(events, events + count);
+#ifndef _WIN32
+    if (DestroyEvents(events, count / 2) != EINVAL) {
+        std::cout << "Part of a bulk-created block was destroyed!" << std::endl;
+        return 1;
+    }
+    // Nor when an event is listed twice, or isn't from the block at all
+    neosmart_event_t last = events[count - 1];
+    events[count - 1] = events[0];
+    if (DestroyEvents(events, count) != EINVAL) {
+        std::cout << "Bulk-created events listed twice were destroyed!" << std::endl;
+        return 1;
+    }
+    neosmart_event_t single = CreateEvent();
+    events[count - 1] = single;
+    if (DestroyEvents(events, count) != EINVAL || DestroyEvents(&single, 1) != EINVAL) {
+        std::cout << "An individually created event was destroyed as a block!" << std::endl;
+        return 1;
+    }
+    DestroyEvent(single);
+    events[count - 1] = last;
+#endif
+    if (DestroyEvents(events, count) != 0) {
+        std::cout << "Reordered bulk-created events couldn't be destroyed!" << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,102 @@
+// Test that messages sent through a shared-memory channel arrive intact and in order in another
+// process, including across ring wrap-around and while the producer is blocked on a full ring, and
+// that failing to create a channel's events fails the channel cleanly.
+#include <fcntl.h>
+#include <iostream>
+#include <pchannel.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace neosmart;
+
+const uint32_t MESSAGES = 100000;
+
+int consumer(const std::string &name) {
+    neosmart_channel_t channel = OpenChannel(name.c_str());
+    if (channel == nullptr) {
+        return 1;
+    }
+
+    for (uint32_t i = 0; i < MESSAGES; ++i) {
+        uint32_t size = 0;
+        const void *message = ChannelRead(channel, size, 5000);
+        if (message == nullptr) {
+            return 2;
+        }
+        // Message sizes vary so that records end up straddling the end of the ring
+        uint32_t value;
+        memcpy(&value, message, sizeof(value));
+        if (value != i || size != sizeof(value) + (i % 61)) {
+            return 3;
+        }
+        if (i % 7 == 0) {
+            ChannelRelease(channel);
+        }
+    }
+    ChannelRelease(channel);
+
+    DestroyChannel(channel);
+    return 0;
+}
+
+int main() {
+    // A shared WFMO pool of our own, rather than the one used by the whole machine
+    std::string pool = "/pevents.test.wfmo." + std::to_string(getpid());
+    setenv("PEVENTS_WFMO_POOL", pool.c_str(), 1);
+
+    std::string name = "test.channel." + std::to_string(getpid());
+
+    // A channel whose events can't be created isn't created either, and leaves nothing behind:
+    // here, its data event's segment was made by a build of pevents with another layout
+    std::string eventSegment = "/pevents._pchannel." + name + ".data";
+    int fd = shm_open(eventSegment.c_str(), O_RDWR | O_CREAT | O_EXCL, 0666);
+    if (fd < 0 || ftruncate(fd, 8) != 0) {
+        std::cout << "Couldn't make a mismatched event segment!" << std::endl;
+        return 1;
+    }
+    close(fd);
+    if (CreateChannel(name.c_str(), 4096) != nullptr || OpenChannel(name.c_str()) != nullptr) {
+        std::cout << "Created a channel without its events!" << std::endl;
+        return 1;
+    }
+    shm_unlink(eventSegment.c_str());
+
+    neosmart_channel_t channel = CreateChannel(name.c_str(), 4096);
+    if (channel == nullptr) {
+        std::cout << "Couldn't create the channel!" << std::endl;
+        return 1;
+    }
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        _exit(consumer(name));
+    }
+
+    for (uint32_t i = 0; i < MESSAGES; ++i) {
+        void *message = ChannelReserve(channel, sizeof(i) + (i % 61), 5000);
+        if (message == nullptr) {
+            std::cout << "Timeout reserving space in the channel!" << std::endl;
+            return 1;
+        }
+        memcpy(message, &i, sizeof(i));
+        if (i % 5 == 0) {
+            ChannelCommit(channel);
+        }
+    }
+    ChannelCommit(channel);
+
+    int status = -1;
+    waitpid(pid, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        std::cout << "Consumer failed with status " << WEXITSTATUS(status) << std::endl;
+        return 1;
+    }
+
+    DestroyChannel(channel);
+    shm_unlink(pool.c_str());
+    return 0;
+}
@@ -0,0 +1,119 @@
+// Test that destroying a handle while other threads are waiting on its event leaves the event
+// alive until they're done with it, and that handles destroyed and reused while being resolved by
+// other threads never resolve to another handle's event, however often they're reused.
+#include <atomic>
+#include <chrono>
+#include <errno.h>
+#include <iostream>
+#include <pevents.h>
+#include <thread>
+#include <vector>
+
+using namespace neosmart;
+
+#define CHECK(condition)                                                                           \
+    if (!(condition)) {                                                                            \
+        std::cout << "Check failed: " #condition << std::endl;                                    \
+        return 1;                                                                                  \
+    }
+
+static const neosmart_allocator_t *heap;
+static std::atomic<int> deallocations(0);
+
+void *CountingAllocate(size_t size, size_t alignment, void *) {
+    return heap->Allocate(size, alignment, heap->Context);
+}
+
+void CountingDeallocate(void *memory, size_t size, size_t alignment, void *) {
+    ++deallocations;
+    heap->Deallocate(memory, size, alignment, heap->Context);
+}
+
+int main() {
+    heap = GetDefaultAllocator();
+    neosmart_allocator_t counting = {CountingAllocate, CountingDeallocate, nullptr};
+    SetDefaultAllocator(&counting);
+
+    // The event outlives its handle for as long as a thread is waiting on it
+    neosmart_handle_t handle = CreateEventHandle();
+    std::atomic<int> result(-1);
+    std::thread waiter([&]() { result = WaitForEvent(handle, 200); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    int before = deallocations;
+    CHECK(DestroyEvent(handle) == 0);
+    CHECK(SetEvent(handle) == EBADF);
+    CHECK(deallocations == before);
+    waiter.join();
+    CHECK(result == WAIT_TIMEOUT);
+    CHECK(deallocations == before + 1);
+
+#ifdef WFMO
+    // Likewise for WaitForMultipleEvents(), which is still woken by the other event
+    neosmart_handle_t handles[2] = {CreateEventHandle(), CreateEventHandle()};
+    int index = -1;
+    std::thread multiWaiter([&]() {
+        result = WaitForMultipleEvents(handles, 2, false, 2000, index);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    before = deallocations;
+    CHECK(DestroyEvent(handles[0]) == 0);
+    CHECK(deallocations == before);
+    CHECK(SetEvent(handles[1]) == 0);
+    multiWaiter.join();
+    CHECK(result == 0 && index == 1);
+    CHECK(deallocations > before);
+    DestroyEvent(handles[1]);
+#endif
+
+    // Resolvers set whichever handle was last published while it's destroyed and its slot reused.
+    // A new handle's event must start out unset.
+    std::atomic<uint32_t> published(0);
+    std::atomic<bool> stop(false);
+    std::vector<std::thread> resolvers;
+    for (int i = 0; i < 3; ++i) {
+        resolvers.emplace_back([&]() {
+            while (!stop) {
+                neosmart_handle_t stale = {published.load()};
+                int set = SetEvent(stale);
+                if (set != 0 && set != EBADF) {
+                    std::cout << "SetEvent() failed with " << set << std::endl;
+                }
+                ResolveHandle(stale);
+            }
+        });
+    }
+    bool misresolved = false;
+    neosmart_handle_t current = CreateEventHandle(true, false);
+    for (int i = 0; i < 3000; ++i) {
+        published = current.Value;
+        std::this_thread::yield();
+        DestroyEvent(current);
+        current = CreateEventHandle(true, false);
+        if (WaitForEvent(current, 0) == 0) {
+            misresolved = true;
+        }
+    }
+    stop = true;
+    for (std::thread &resolver : resolvers) {
+        resolver.join();
+    }
+    DestroyEvent(current);
+    CHECK(!misresolved);
+
+    // A stale handle stays stale however many times its slot is reused, past the 4095 generations
+    // a slot can go through
+    neosmart_handle_t stale = CreateEventHandle();
+    DestroyEvent(stale);
+    bool aliased = false;
+    for (int i = 0; i < 10000; ++i) {
+        neosmart_handle_t handle = CreateEventHandle();
+        if (handle.Value == stale.Value || SetEvent(stale) != EBADF) {
+            aliased = true;
+        }
+        DestroyEvent(handle);
+    }
+    CHECK(!aliased);
+
+    SetDefaultAllocator(nullptr);
+    return 0;
+}
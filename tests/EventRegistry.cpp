@@ -0,0 +1,138 @@
+// Test that live events are listed with their names, states and waiters, that destroyed events
+// drop out, and that the registry can be dumped as text on demand or on a signal
+#include <algorithm>
+#include <iostream>
+#include <pevents.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string>
+#include <sys/mman.h>
+#include <thread>
+#include <unistd.h>
+
+using namespace neosmart;
+
+#define CHECK(condition)                                                                           \
+    if (!(condition)) {                                                                            \
+        std::cout << "Check failed: " #condition << std::endl;                                    \
+        return 1;                                                                                  \
+    }
+
+static neosmart_event_t_ staticEvent(true, true);
+
+// Returns the registry's entry for `event`, or an entry with a null Event if it isn't listed
+static neosmart_event_info_t Find(neosmart_event_t event) {
+    neosmart_event_info_t events[16] = {};
+    int count = std::min(ListEvents(events, 16), 16);
+    for (int i = 0; i < count; ++i) {
+        if (events[i].Event == event) {
+            return events[i];
+        }
+    }
+    return neosmart_event_info_t{};
+}
+
+static std::string ReadAll(int fd) {
+    std::string text;
+    char buffer[256];
+    lseek(fd, 0, SEEK_SET);
+    ssize_t read;
+    while ((read = ::read(fd, buffer, sizeof(buffer))) > 0) {
+        text.append(buffer, read);
+    }
+    return text;
+}
+
+int main() {
+    neosmart_event_t ready = CreateEvent();
+    neosmart_event_t other = CreateEvent(true, false);
+    SetEventName(ready, "ready");
+    CHECK(ListEvents(NULL, 0) == 2);
+    CHECK(Find(&staticEvent).Event == NULL);
+
+    // Static events join once named
+    SetEventName(&staticEvent, "a name that is much too long to be kept in full");
+    neosmart_event_info_t info = Find(&staticEvent);
+    CHECK(info.Event == &staticEvent && info.ManualReset && info.State);
+    CHECK(std::string(info.Name).size() == PEVENTS_DEBUG_NAME_LENGTH - 1);
+
+    std::thread waiter([&]() { WaitForEvent(ready); });
+#ifdef WFMO
+    std::thread multiWaiter([&]() {
+        neosmart_event_t events[2] = {other, ready};
+        int index;
+        WaitForMultipleEvents(events, 2, true, -1ul, index);
+    });
+#endif
+    int expected = 1;
+#ifdef WFMO
+    expected = 2;
+#endif
+    for (int i = 0; i < 1000; ++i) {
+        info = Find(ready);
+        if (info.Waiters + info.MultiWaiters == expected) {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    CHECK(std::string(info.Name) == "ready" && !info.ManualReset && !info.State && !info.Named);
+    CHECK(info.Waiters == 1);
+    CHECK(info.MultiWaiters == expected - 1);
+
+    char path[] = "/tmp/pevents-registry-XXXXXX";
+    int fd = mkstemp(path);
+    CHECK(fd >= 0);
+    unlink(path);
+    DumpEvents(fd);
+    std::string dump = ReadAll(fd);
+    CHECK(dump.find("3 live events") != std::string::npos);
+    CHECK(dump.find("\"ready\" auto unset waiters=1") != std::string::npos);
+    CHECK(dump.find("  wait tid=") != std::string::npos);
+#ifdef WFMO
+    CHECK(dump.find("wait-all index=1") != std::string::npos);
+#endif
+
+    // The signal-triggered dump is written from a thread of its own, so wait for it to land
+    CHECK(ftruncate(fd, 0) == 0);
+    lseek(fd, 0, SEEK_SET);
+    CHECK(EnableEventDumpSignal(SIGUSR1, fd) == 0);
+    raise(SIGUSR1);
+    for (int i = 0; i < 1000 && ReadAll(fd).find("\"ready\"") == std::string::npos; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    CHECK(ReadAll(fd).find("3 live events") != std::string::npos);
+
+    // Each set of `ready` releases one waiter
+    SetEvent(other);
+    for (info = Find(ready); info.Waiters != 0 || info.MultiWaiters != 0; info = Find(ready)) {
+        SetEvent(ready);
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+#ifdef WFMO
+    multiWaiter.join();
+#endif
+    waiter.join();
+    ResetEvent(ready);
+    info = Find(ready);
+    CHECK(info.Waiters == 0 && info.MultiWaiters == 0);
+
+#ifdef NAMED
+    // In a shared WFMO pool of our own, rather than the one used by the whole machine
+    std::string pool = "/pevents.test.wfmo." + std::to_string(getpid());
+    setenv("PEVENTS_WFMO_POOL", pool.c_str(), 1);
+    neosmart_event_t named = CreateEvent("pevents-registry-test", true, true);
+    info = Find(named);
+    CHECK(info.Event == named && info.Named && info.ManualReset && info.State);
+    CHECK(info.Waiters == -1);
+    DestroyEvent(named);
+    CHECK(Find(named).Event == NULL);
+    shm_unlink(pool.c_str());
+#endif
+
+    DestroyEvent(other);
+    CHECK(Find(other).Event == NULL);
+    CHECK(ListEvents(NULL, 0) == 2);
+    DestroyEvent(ready);
+    close(fd);
+    return 0;
+}
@@ -0,0 +1,67 @@
+// Test the counters kept when built with STATS, per event and summed over the whole process
+#include <chrono>
+#include <iostream>
+#include <pevents.h>
+#include <thread>
+
+using namespace neosmart;
+
+#define CHECK(condition)                                                                           \
+    if (!(condition)) {                                                                            \
+        std::cout << "Check failed: " #condition << std::endl;                                    \
+        return 1;                                                                                  \
+    }
+
+int main() {
+    neosmart_event_stats_t before;
+    GetGlobalEventStats(&before);
+
+    neosmart_event_t event = CreateEvent(true, false);
+    SetEvent(event);
+    SetEvent(event);
+    WaitForEvent(event, 0);
+    ResetEvent(event);
+    WaitForEvent(event, 0);
+
+    // Two threads blocked on the event at once
+    std::thread waiters[2];
+    for (auto &waiter : waiters) {
+        waiter = std::thread([&]() { WaitForEvent(event); });
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    SetEvent(event);
+    for (auto &waiter : waiters) {
+        waiter.join();
+    }
+
+    neosmart_event_stats_t stats;
+    CHECK(GetEventStats(event, &stats) == 0);
+    CHECK(stats.Sets == 3);
+    CHECK(stats.RedundantSets == 1);
+    CHECK(stats.Resets == 1);
+    CHECK(stats.Waits == 3);
+    CHECK(stats.Timeouts == 1);
+    CHECK(stats.PeakWaiters == 2);
+
+#ifdef WFMO
+    // An expired registration is left on `event` by the first wait, then cleaned up by the second
+    neosmart_event_t other = CreateEvent();
+    neosmart_event_t events[2] = {other, event};
+    ResetEvent(event);
+    CHECK(WaitForMultipleEvents(events, 2, false, 0) == WAIT_TIMEOUT);
+    CHECK(WaitForMultipleEvents(events, 2, false, 0) == WAIT_TIMEOUT);
+    CHECK(GetEventStats(event, &stats) == 0);
+    CHECK(stats.WfmoRegistrations == 2);
+    CHECK(stats.ExpiredWaitsRemoved == 1);
+    DestroyEvent(other);
+#endif
+
+    neosmart_event_stats_t after;
+    GetGlobalEventStats(&after);
+    CHECK(after.Sets - before.Sets >= 3);
+    CHECK(after.Waits - before.Waits >= 3);
+    CHECK(after.PeakWaiters >= 2);
+
+    DestroyEvent(event);
+    return 0;
+}
@@ -0,0 +1,62 @@
+// Test that traced calls are written out as Chrome trace JSON, with a flow arrow from a set to
+// the wait it woke
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <pevents.h>
+#include <sstream>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <unistd.h>
+
+using namespace neosmart;
+
+int main() {
+    neosmart_event_t event = CreateEvent();
+    std::thread waiter([&]() { WaitForEvent(event); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    SetEvent(event);
+    waiter.join();
+    ResetEvent(event);
+
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/pevents-trace-%d.json", (int)getpid());
+    if (WriteEventTrace(path) != 0) {
+        std::cout << "Couldn't write the trace!" << std::endl;
+        return 1;
+    }
+    std::ifstream file(path);
+    std::stringstream contents;
+    contents << file.rdbuf();
+    std::string trace = contents.str();
+    unlink(path);
+    DestroyEvent(event);
+
+    if (trace.find("{\"displayTimeUnit\"") != 0 || trace.rfind("]}") == std::string::npos) {
+        std::cout << "Trace isn't a JSON object!" << std::endl;
+        return 1;
+    }
+    for (const char *name : {"\"SetEvent\"", "\"WaitForEvent\"", "\"ResetEvent\""}) {
+        if (trace.find(name) == std::string::npos) {
+            std::cout << "Trace is missing " << name << "!" << std::endl;
+            return 1;
+        }
+    }
+
+    // The set starts a flow, and the woken wait finishes it
+    size_t start = trace.find("\"ph\":\"s\",\"id\":");
+    if (start == std::string::npos) {
+        std::cout << "Set didn't start a flow!" << std::endl;
+        return 1;
+    }
+    start += strlen("\"ph\":\"s\",\"id\":");
+    std::string id = trace.substr(start, trace.find(',', start) - start);
+    if (trace.find("\"bp\":\"e\",\"id\":" + id + ",") == std::string::npos) {
+        std::cout << "Woken wait didn't finish the set's flow!" << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
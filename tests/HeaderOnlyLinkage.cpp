@@ -0,0 +1,55 @@
+// Test that a header-only build links when pevents is included from more than one file, and that
+// global state (such as the default allocator) is shared between them rather than duplicated.
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+#include <iostream>
+#include <pevents.h>
+
+using namespace neosmart;
+
+// Defined in HeaderOnlyLinkageOther.cpp
+const neosmart_allocator_t *OtherDefaultAllocator();
+int SetInOther(neosmart_event_t event);
+
+static int allocations = 0;
+
+// Counts allocations made through the wrapped (heap) allocator
+static void *CountingAllocate(size_t size, size_t alignment, void *context) {
+    auto heap = static_cast<const neosmart_allocator_t *>(context);
+    ++allocations;
+    return heap->Allocate(size, alignment, heap->Context);
+}
+
+static void CountingDeallocate(void *memory, size_t size, size_t alignment, void *context) {
+    auto heap = static_cast<const neosmart_allocator_t *>(context);
+    heap->Deallocate(memory, size, alignment, heap->Context);
+}
+
+int main() {
+    neosmart_allocator_t allocator = {CountingAllocate, CountingDeallocate,
+                                      const_cast<neosmart_allocator_t *>(GetDefaultAllocator())};
+    SetDefaultAllocator(&allocator);
+    if (OtherDefaultAllocator() != &allocator) {
+        std::cout << "Default allocator isn't shared between files!" << std::endl;
+        return 1;
+    }
+
+    neosmart_event_t event = CreateEvent();
+#ifndef _WIN32
+    if (allocations != 1) {
+        std::cout << "Event wasn't created through the shared default allocator!" << std::endl;
+        return 1;
+    }
+#endif
+
+    SetInOther(event);
+    if (WaitForEvent(event, 0) != 0) {
+        std::cout << "Event set in another file wasn't set!" << std::endl;
+        return 1;
+    }
+
+    DestroyEvent(event);
+    SetDefaultAllocator(NULL);
+    return 0;
+}
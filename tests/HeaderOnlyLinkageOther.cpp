@@ -0,0 +1,20 @@
+// The second half of HeaderOnlyLinkage, which includes pevents the other way around
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <basic_event.h>
+#endif
+#include <pevents.h>
+#ifdef NAMED
+#include <pchannel.h>
+#endif
+
+using namespace neosmart;
+
+const neosmart_allocator_t *OtherDefaultAllocator() {
+    return GetDefaultAllocator();
+}
+
+int SetInOther(neosmart_event_t event) {
+    return SetEvent(event);
+}
@@ -0,0 +1,78 @@
+// Test that contention on events' mutexes is measured, attributed to the right event and
+// operation, and ranked
+#include <atomic>
+#include <errno.h>
+#include <iostream>
+#include <pevents.h>
+#include <thread>
+#include <vector>
+
+using namespace neosmart;
+
+#define CHECK(condition)                                                                           \
+    if (!(condition)) {                                                                            \
+        std::cout << "Check failed: " #condition << std::endl;                                    \
+        return 1;                                                                                  \
+    }
+
+int main() {
+    neosmart_event_t quiet = CreateEvent();
+    neosmart_event_t busy = CreateEvent(true, false);
+    SetEvent(quiet);
+    WaitForEvent(quiet, 0);
+
+    // Hammer `busy` from several threads until its mutex has been fought over for a while
+    std::atomic<bool> stop(false);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i) {
+        threads.emplace_back([&, i]() {
+            while (!stop.load()) {
+                if (i % 2 == 0) {
+                    SetEvent(busy);
+                } else {
+                    ResetEvent(busy);
+                }
+            }
+        });
+    }
+    neosmart_event_contention_t contention;
+    for (int i = 0; i < 10 * 1000; ++i) {
+        if (GetEventContention(busy, &contention) == 0 &&
+            contention.Ops[LOCK_OP_SET].Contended + contention.Ops[LOCK_OP_RESET].Contended >
+                100) {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    stop = true;
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    CHECK(GetEventContention(quiet, &contention) == ENOENT);
+    CHECK(GetEventContention(busy, &contention) == 0);
+    CHECK(contention.Event == busy && !contention.Destroyed);
+    CHECK(contention.WaitNanoseconds > 0);
+    CHECK(contention.Ops[LOCK_OP_SET].Acquisitions > 0);
+    CHECK(contention.Ops[LOCK_OP_SET].HoldNanoseconds > 0);
+    CHECK(contention.Ops[LOCK_OP_WAIT].Contended == 0);
+
+    neosmart_event_contention_t top[4];
+    CHECK(GetContendedEvents(top, 4) >= 1);
+    CHECK(top[0].Event == busy);
+
+#ifdef WFMO
+    neosmart_event_t events[2] = {quiet, busy};
+    ResetEvent(busy);
+    WaitForMultipleEvents(events, 2, false, 0);
+    neosmart_lock_stats_t waiters[LOCK_OPS];
+    GetWaiterContention(waiters);
+    CHECK(waiters[LOCK_OP_REGISTER].Acquisitions > 0);
+#endif
+
+    DestroyEvent(busy);
+    CHECK(GetContendedEvents(top, 4) >= 1);
+    CHECK(top[0].Destroyed);
+    DestroyEvent(quiet);
+    return 0;
+}
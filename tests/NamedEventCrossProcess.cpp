@@ -0,0 +1,96 @@
+// Test that named events can be signalled and waited on across processes, including as part of a
+// WaitForMultipleEvents() call mixing named and unnamed events.
+#include <iostream>
+#include <pevents.h>
+#include <stdlib.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace neosmart;
+
+int child(const std::string &ping, const std::string &pong) {
+    neosmart_event_t pingEvent = OpenEvent(ping.c_str());
+    neosmart_event_t pongEvent = OpenEvent(pong.c_str());
+    if (pingEvent == nullptr || pongEvent == nullptr) {
+        return 1;
+    }
+
+    for (int i = 0; i < 100; ++i) {
+        if (WaitForEvent(pingEvent, 2000) != 0) {
+            return 2;
+        }
+        SetEvent(pongEvent);
+    }
+
+    DestroyEvent(pingEvent);
+    DestroyEvent(pongEvent);
+    return 0;
+}
+
+int main() {
+    // A shared WFMO pool of our own, rather than the one used by the whole machine
+    std::string pool = "/pevents.test.wfmo." + std::to_string(getpid());
+    setenv("PEVENTS_WFMO_POOL", pool.c_str(), 1);
+
+    std::string ping = "test.ping." + std::to_string(getpid());
+    std::string pong = "test.pong." + std::to_string(getpid());
+
+    if (OpenEvent(ping.c_str()) != nullptr) {
+        std::cout << "OpenEvent() succeeded for an event that doesn't exist!" << std::endl;
+        return 1;
+    }
+
+    neosmart_event_t pingEvent = CreateEvent(ping.c_str(), false, false);
+    neosmart_event_t pongEvent = CreateEvent(pong.c_str(), false, false);
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        _exit(child(ping, pong));
+    }
+
+#ifdef WFMO
+    neosmart_event_t local = CreateEvent(true, false);
+    neosmart_event_t waitOn[] = {local, pongEvent};
+#endif
+
+    for (int i = 0; i < 100; ++i) {
+        SetEvent(pingEvent);
+#ifdef WFMO
+        int index = -1;
+        int result = WaitForMultipleEvents(waitOn, 2, false, 2000, index);
+        if (result != 0 || index != 1) {
+            std::cout << "Cross-process WFMO failed with result " << result << std::endl;
+            return 1;
+        }
+#else
+        if (WaitForEvent(pongEvent, 2000) != 0) {
+            std::cout << "Timeout waiting for the other process!" << std::endl;
+            return 1;
+        }
+#endif
+    }
+
+    int status = -1;
+    waitpid(pid, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        std::cout << "Child process failed!" << std::endl;
+        return 1;
+    }
+
+#ifdef WFMO
+    DestroyEvent(local);
+#endif
+    DestroyEvent(pingEvent);
+    DestroyEvent(pongEvent);
+
+    // Closing the last handle removes the event
+    if (OpenEvent(ping.c_str()) != nullptr) {
+        std::cout << "Named event outlived its last handle!" << std::endl;
+        return 1;
+    }
+
+    shm_unlink(pool.c_str());
+    return 0;
+}
@@ -0,0 +1,96 @@
+// Test that zero-timeout waits never report a timeout for an event that's set, even with its lock
+// held by another thread, and that IsEventSet() neither takes the lock nor consumes the event
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <pevents.h>
+#include <thread>
+
+using namespace neosmart;
+
+#define CHECK(condition)                                                                           \
+    if (!(condition)) {                                                                            \
+        std::cout << "Check failed: " #condition << std::endl;                                    \
+        return 1;                                                                                  \
+    }
+
+neosmart_event_t_ manualEvent(true, true);
+neosmart_event_t_ autoEvent(false, true);
+neosmart_event_t_ unsetEvent(false, false);
+
+// Holds each event's lock for a while, as a thread in SetEvent() or ResetEvent() would
+static std::thread HoldLocks(std::atomic<bool> &held) {
+    return std::thread([&]() {
+        for (neosmart_event_t_ *event : {&manualEvent, &autoEvent, &unsetEvent}) {
+            pthread_mutex_lock(&event->Mutex);
+        }
+        held = true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        for (neosmart_event_t_ *event : {&manualEvent, &autoEvent, &unsetEvent}) {
+            pthread_mutex_unlock(&event->Mutex);
+        }
+    });
+}
+
+int main() {
+    std::atomic<bool> held(false);
+    std::thread holder = HoldLocks(held);
+    while (!held) {
+        std::this_thread::yield();
+    }
+
+    // Answered without waiting for the locks
+    auto start = std::chrono::steady_clock::now();
+    CHECK(IsEventSet(&manualEvent));
+    CHECK(IsEventSet(&autoEvent));
+    CHECK(!IsEventSet(&unsetEvent));
+    CHECK(WaitForEvent(&unsetEvent, 0) == WAIT_TIMEOUT);
+    CHECK(std::chrono::steady_clock::now() - start < std::chrono::milliseconds(25));
+
+    // Set events are obtained once the lock is free, rather than reported as timed out
+    CHECK(WaitForEvent(&manualEvent, 0) == 0);
+    CHECK(WaitForEvent(&autoEvent, 0) == 0);
+    holder.join();
+
+    // Only the wait consumed the auto-reset event
+    CHECK(IsEventSet(&manualEvent));
+    CHECK(!IsEventSet(&autoEvent));
+    CHECK(WaitForEvent(&autoEvent, 0) == WAIT_TIMEOUT);
+
+    // Under contention from sets and resets of other threads, a set event is never missed
+    neosmart_event_t event = CreateEvent(true, true);
+    neosmart_event_t other = CreateEvent(true, false);
+    std::atomic<bool> stop(false);
+    std::thread setter([&]() {
+        while (!stop) {
+            SetEvent(event);
+            SetEvent(other);
+            ResetEvent(other);
+        }
+    });
+    for (int i = 0; i < 100 * 1000; ++i) {
+        CHECK(WaitForEvent(event, 0) == 0);
+    }
+    stop = true;
+    setter.join();
+    DestroyEvent(event);
+    DestroyEvent(other);
+
+    // Whatever was written before a set is seen by a thread finding the event set
+    for (int i = 0; i < 1000; ++i) {
+        neosmart_event_t ready = CreateEvent(true, false);
+        int payload = 0;
+        std::thread publisher([&]() {
+            payload = i + 1;
+            SetEvent(ready);
+        });
+        while (!IsEventSet(ready)) {
+            std::this_thread::yield();
+        }
+        CHECK(payload == i + 1);
+        publisher.join();
+        DestroyEvent(ready);
+    }
+
+    return 0;
+}
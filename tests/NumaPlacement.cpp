@@ -0,0 +1,62 @@
+// Test that events allocated through the NUMA allocators are placed on the requested node and
+// behave like any other event, including when freed from a different thread.
+#include <iostream>
+#include <pevents.h>
+#include <sys/syscall.h>
+#include <thread>
+#include <unistd.h>
+
+using namespace neosmart;
+
+// get_mempolicy(MPOL_F_NODE | MPOL_F_ADDR) reports the node backing an address
+int NodeOf(void *address) {
+    int node = -1;
+    if (syscall(SYS_get_mempolicy, &node, nullptr, 0, address, 3) != 0) {
+        return -1;
+    }
+    return node;
+}
+
+int main() {
+    int local = GetCurrentNumaNode();
+    neosmart_event_t events[3];
+    events[0] = CreateEvent(false, false, GetNumaAllocator(0));
+    events[1] = CreateEvent(true, true, GetNumaAllocator());
+    CreateEvents(&events[2], 1, EVENT_CACHE_ALIGNED);
+
+    int node = NodeOf(events[0]);
+    if (node != -1 && node != 0) {
+        std::cout << "Event requested on node 0 was placed on node " << node << std::endl;
+        return 1;
+    }
+    node = NodeOf(events[1]);
+    if (node != -1 && node != local) {
+        std::cout << "Event requested on local node " << local << " was placed on node " << node
+                  << std::endl;
+        return 1;
+    }
+
+    if (WaitForEvent(events[1], 0) != 0 || WaitForEvent(events[0], 0) != WAIT_TIMEOUT) {
+        std::cout << "NUMA-placed events have the wrong state!" << std::endl;
+        return 1;
+    }
+
+#ifdef WFMO
+    std::thread setter([&]() { SetEvent(events[0]); });
+    int index = -1;
+    if (WaitForMultipleEvents(events, 1, false, 1000, index) != 0 || index != 0) {
+        std::cout << "WFMO on a NUMA-placed event failed!" << std::endl;
+        return 1;
+    }
+    setter.join();
+#endif
+
+    std::thread destroyer([&]() {
+        DestroyEvent(events[0]);
+        DestroyEvent(events[1]);
+    });
+    destroyer.join();
+    DestroyEvents(&events[2], 1);
+
+    return 0;
+}
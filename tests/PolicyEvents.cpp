@@ -0,0 +1,80 @@
+// Test events whose behaviour is picked at compile time through basic_event's policies, including
+// WFMO over multi-wait instantiations.
+#include <basic_event.h>
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+using namespace neosmart;
+
+typedef basic_event<auto_reset> auto_event;
+typedef basic_event<manual_reset, spinning_wait<>> spinning_manual_event;
+typedef basic_event<auto_reset, blocking_wait, multi_wait> multi_event;
+
+// Single-wait events don't pay for a wait list
+static_assert(sizeof(auto_event) < sizeof(multi_event), "single_wait event carries WFMO state");
+static_assert(sizeof(auto_event) <= sizeof(basic_event<runtime_reset>),
+              "compile-time reset policy takes up space");
+
+int main() {
+    auto_event autoEvent(true);
+    if (autoEvent.Wait(0) != 0 || autoEvent.Wait(0) != WAIT_TIMEOUT) {
+        std::cout << "Auto-reset event didn't reset!" << std::endl;
+        return 1;
+    }
+
+    spinning_manual_event manual;
+    if (manual.Wait(10) != WAIT_TIMEOUT) {
+        std::cout << "Spinning wait on unset event didn't time out!" << std::endl;
+        return 1;
+    }
+    std::thread setter([&]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        manual.Set();
+    });
+    if (manual.Wait() != 0 || manual.Wait(0) != 0) {
+        std::cout << "Manual-reset event wasn't set!" << std::endl;
+        return 1;
+    }
+    setter.join();
+    manual.Reset();
+    if (manual.Wait(0) != WAIT_TIMEOUT) {
+        std::cout << "Manual-reset event wasn't reset!" << std::endl;
+        return 1;
+    }
+
+    multi_event events[3];
+    multi_event *pointers[3] = {&events[0], &events[1], &events[2]};
+    setter = std::thread([&]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        events[2].Set();
+    });
+    int index = -1;
+    if (WaitForMultipleEvents(pointers, 3, false, 1000, index) != 0 || index != 2) {
+        std::cout << "WFMO over multi-wait events returned the wrong index!" << std::endl;
+        return 1;
+    }
+    setter.join();
+    // Consumed by the WFMO
+    if (events[2].Wait(0) != WAIT_TIMEOUT) {
+        std::cout << "Auto-reset event wasn't consumed by WFMO!" << std::endl;
+        return 1;
+    }
+
+    events[0].Set();
+    events[1].Set();
+    if (WaitForMultipleEvents(pointers, 3, true, 10) != WAIT_TIMEOUT) {
+        std::cout << "WFMO wait-all returned before all events were set!" << std::endl;
+        return 1;
+    }
+    // As with the C-style API, wait-all takes events as it goes, so start over
+    for (int i = 0; i < 3; ++i) {
+        events[i].Set();
+    }
+    if (WaitForMultipleEvents(pointers, 3, true, 0) != 0) {
+        std::cout << "WFMO wait-all failed with all events set!" << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
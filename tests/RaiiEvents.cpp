@@ -0,0 +1,103 @@
+// Test neosmart::Event, the owning event with inline storage: it should allocate nothing, work
+// with the C-style API through native(), and carry its state across moves.
+#include <iostream>
+#include <pevents.h>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+using namespace neosmart;
+
+static_assert(!std::is_copy_constructible<Event>::value, "Event is copyable");
+static_assert(std::is_nothrow_move_constructible<Event>::value, "Event isn't movable");
+static_assert(sizeof(Event) == sizeof(neosmart_event_t_), "Event carries more than its event");
+
+static size_t allocations = 0;
+
+void *CountingAllocate(size_t size, size_t alignment, void *context) {
+    auto heap = static_cast<const neosmart_allocator_t *>(context);
+    ++allocations;
+    return heap->Allocate(size, alignment, heap->Context);
+}
+
+void CountingDeallocate(void *memory, size_t size, size_t alignment, void *context) {
+    auto heap = static_cast<const neosmart_allocator_t *>(context);
+    heap->Deallocate(memory, size, alignment, heap->Context);
+}
+
+int main() {
+    neosmart_allocator_t allocator = {CountingAllocate, CountingDeallocate,
+                                      const_cast<neosmart_allocator_t *>(GetDefaultAllocator())};
+    SetDefaultAllocator(&allocator);
+
+    {
+        Event event;
+        std::thread thread([&]() { SetEvent(event.native()); });
+        if (event.Wait(1000) != 0) {
+            std::cout << "Event set through native() wasn't set!" << std::endl;
+            return 1;
+        }
+        thread.join();
+        if (event.Wait(0) != WAIT_TIMEOUT) {
+            std::cout << "Default Event isn't auto-reset!" << std::endl;
+            return 1;
+        }
+    }
+
+    // Other than, when tracing, the ring each of the two threads records into, and the histogram
+    // a woken wait is sampled into when measuring latencies
+    size_t expected = 0;
+#ifdef TRACE
+    expected += 2;
+#endif
+#ifdef LATENCY
+    expected += 1;
+#endif
+    if (allocations > expected) {
+        std::cout << "Event allocated memory!" << std::endl;
+        return 1;
+    }
+    SetDefaultAllocator(NULL);
+
+    Event manual(true, true);
+    Event moved(std::move(manual));
+    if (moved.Wait(0) != 0 || moved.Wait(0) != 0) {
+        std::cout << "Moved event lost its state or reset mode!" << std::endl;
+        return 1;
+    }
+    if (manual.Wait(0) != WAIT_TIMEOUT) {
+        std::cout << "Moved-from event was left set!" << std::endl;
+        return 1;
+    }
+
+    Event assigned;
+    assigned = std::move(moved);
+    if (assigned.Wait(0) != 0 || assigned.Wait(0) != 0) {
+        std::cout << "Move-assigned event lost its state or reset mode!" << std::endl;
+        return 1;
+    }
+
+    std::vector<Event> events;
+    for (int i = 0; i < 8; ++i) {
+        events.emplace_back(false, i == 5);
+    }
+#ifdef WFMO
+    neosmart_event_t natives[8];
+    for (int i = 0; i < 8; ++i) {
+        natives[i] = events[i].native();
+    }
+    int index = -1;
+    if (WaitForMultipleEvents(natives, 8, false, 0, index) != 0 || index != 5) {
+        std::cout << "WFMO over native() events returned the wrong index!" << std::endl;
+        return 1;
+    }
+#else
+    if (events[5].Wait(0) != 0) {
+        std::cout << "Event lost its state when its vector grew!" << std::endl;
+        return 1;
+    }
+#endif
+
+    return 0;
+}
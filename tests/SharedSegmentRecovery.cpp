@@ -0,0 +1,123 @@
+// Test that named events whose segment was left unfinished or was made by a build with another
+// layout fail to open rather than hang, and that shared WFMO slots held by processes that died
+// mid-wait are taken back, without waits they registered consuming events.
+#include <errno.h>
+#include <fcntl.h>
+#include <iostream>
+#include <pevents.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace neosmart;
+
+#define CHECK(condition)                                                                           \
+    if (!(condition)) {                                                                            \
+        std::cout << "Check failed: " #condition << std::endl;                                    \
+        return 1;                                                                                  \
+    }
+
+// Creates the segment behind the named event `name` as a process that died before finishing
+// would have left it
+static void LeaveSegment(const std::string &name, off_t size) {
+    std::string path = "/pevents." + name;
+    int fd = shm_open(path.c_str(), O_RDWR | O_CREAT | O_EXCL, 0666);
+    if (ftruncate(fd, size) != 0) {
+        std::cout << "Couldn't size the segment" << std::endl;
+    }
+    close(fd);
+}
+
+int main() {
+    // A shared WFMO pool of our own, rather than the one used by the whole machine
+    std::string pool = "/pevents.test.wfmo." + std::to_string(getpid());
+    setenv("PEVENTS_WFMO_POOL", pool.c_str(), 1);
+
+    std::string prefix = "test.recovery." + std::to_string(getpid()) + ".";
+
+    // Made by a build of pevents with a different layout
+    std::string mismatched = prefix + "mismatched";
+    LeaveSegment(mismatched, 8);
+    CHECK(CreateEvent(mismatched.c_str()) == nullptr && errno == EINVAL);
+    CHECK(OpenEvent(mismatched.c_str()) == nullptr && errno == EINVAL);
+    shm_unlink(("/pevents." + mismatched).c_str());
+
+    // Never sized by its creator
+    std::string unfinished = prefix + "unfinished";
+    LeaveSegment(unfinished, 0);
+    CHECK(CreateEvent(unfinished.c_str()) == nullptr && errno == ETIMEDOUT);
+    shm_unlink(("/pevents." + unfinished).c_str());
+
+#ifdef WFMO
+    // More waits than the shared WFMO pool holds (1024 slots by default) are left behind by
+    // processes killed while waiting on a named event of their own. The first also waits on
+    // `shared`, which outlives it.
+    std::string sharedName = prefix + "shared";
+    neosmart_event_t shared = CreateEvent(sharedName.c_str(), false, false);
+    CHECK(shared != nullptr);
+    const int batches = 11;
+    const int batchSize = 100;
+    for (int batch = 0; batch < batches; ++batch) {
+        int ready[2];
+        CHECK(pipe(ready) == 0);
+        std::vector<neosmart_event_t> events;
+        std::vector<pid_t> children;
+        for (int i = 0; i < batchSize; ++i) {
+            std::string name = prefix + std::to_string(batch * batchSize + i);
+            neosmart_event_t event = CreateEvent(name.c_str(), false, false);
+            CHECK(event != nullptr);
+            events.push_back(event);
+
+            pid_t pid = fork();
+            if (pid == 0) {
+                neosmart_event_t waitOn[] = {event, shared};
+                int count = batch == 0 && i == 0 ? 2 : 1;
+                char byte = 0;
+                if (write(ready[1], &byte, 1) != 1) {
+                    _exit(2);
+                }
+                WaitForMultipleEvents(waitOn, count, false, -1ul);
+                // Only reached should the wait fail
+                _exit(1);
+            }
+            children.push_back(pid);
+        }
+        for (int i = 0; i < batchSize; ++i) {
+            char byte;
+            CHECK(read(ready[0], &byte, 1) == 1);
+        }
+        close(ready[0]);
+        close(ready[1]);
+        usleep(50 * 1000);
+
+        for (pid_t child : children) {
+            kill(child, SIGKILL);
+        }
+        for (pid_t child : children) {
+            int status;
+            CHECK(waitpid(child, &status, 0) == child);
+            // Exited only if it couldn't get a slot
+            CHECK(WIFSIGNALED(status));
+        }
+        for (neosmart_event_t event : events) {
+            DestroyEvent(event);
+        }
+    }
+
+    // The dead waiter registered with `shared` doesn't take the event from the living
+    SetEvent(shared);
+    CHECK(WaitForEvent(shared, 0) == 0);
+    neosmart_event_t local = CreateEvent();
+    neosmart_event_t waitOn[] = {local, shared};
+    CHECK(WaitForMultipleEvents(waitOn, 2, false, 0) == WAIT_TIMEOUT);
+    DestroyEvent(local);
+    DestroyEvent(shared);
+#endif
+
+    shm_unlink(pool.c_str());
+    return 0;
+}
@@ -0,0 +1,60 @@
+// Test that handle-table events work like regular events, and that using a handle after the event
+// has been destroyed is detected even once its slot has been reused.
+#include <errno.h>
+#include <iostream>
+#include <pevents.h>
+#include <vector>
+
+using namespace neosmart;
+
+int main() {
+    neosmart_handle_t event = CreateEventHandle(false, true);
+    if (WaitForEvent(event, 0) != 0 || WaitForEvent(event, 0) != WAIT_TIMEOUT) {
+        std::cout << "Auto-reset event behind a handle didn't reset!" << std::endl;
+        return 1;
+    }
+
+    DestroyEvent(event);
+    if (SetEvent(event) != EBADF || WaitForEvent(event, 0) != EBADF) {
+        std::cout << "Stale handle was not rejected!" << std::endl;
+        return 1;
+    }
+
+    // The freed slot is reused, but under a new generation
+    neosmart_handle_t reused = CreateEventHandle(true, false);
+    if (reused.Value == event.Value || ResolveHandle(event) != nullptr) {
+        std::cout << "Reused slot resolves stale handle!" << std::endl;
+        return 1;
+    }
+    if (DestroyEvent(event) != EBADF) {
+        std::cout << "Stale handle was destroyed twice!" << std::endl;
+        return 1;
+    }
+
+#ifdef WFMO
+    std::vector<neosmart_handle_t> handles;
+    for (int i = 0; i < 100; ++i) {
+        handles.push_back(CreateEventHandle(true, false));
+    }
+    SetEvent(handles[42]);
+    int index = -1;
+    if (WaitForMultipleEvents(handles.data(), (int)handles.size(), false, 0, index) != 0 ||
+        index != 42) {
+        std::cout << "WFMO over handles returned the wrong index!" << std::endl;
+        return 1;
+    }
+    DestroyEvent(handles[10]);
+    if (WaitForMultipleEvents(handles.data(), (int)handles.size(), false, 0) != EBADF) {
+        std::cout << "WFMO accepted a stale handle!" << std::endl;
+        return 1;
+    }
+    for (int i = 0; i < 100; ++i) {
+        if (i != 10) {
+            DestroyEvent(handles[i]);
+        }
+    }
+#endif
+
+    DestroyEvent(reused);
+    return 0;
+}
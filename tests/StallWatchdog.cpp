@@ -0,0 +1,138 @@
+// Test that the watchdog reports waits that run past its threshold exactly once, naming the
+// events and their last setters, and that it finds threads blocked waiting on each other
+#include <atomic>
+#include <iostream>
+#include <mutex>
+#include <pevents.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace neosmart;
+
+#define CHECK(condition)                                                                           \
+    if (!(condition)) {                                                                            \
+        std::cout << "Check failed: " #condition << std::endl;                                    \
+        return 1;                                                                                  \
+    }
+
+static std::mutex mutex;
+static std::vector<neosmart_stall_t> stalls;
+
+static void OnStall(const neosmart_stall_t *stall, void *context) {
+    std::lock_guard<std::mutex> lock(mutex);
+    stalls.push_back(*stall);
+    ++*static_cast<std::atomic<int> *>(context);
+}
+
+// Waits for the watchdog to have reported `count` stalls in all
+static bool AwaitStalls(std::atomic<int> &reported, int count) {
+    for (int i = 0; i < 2000 && reported.load() < count; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return reported.load() >= count;
+}
+
+static const neosmart_stall_t *FindStall(uint64_t threadId) {
+    for (const neosmart_stall_t &stall : stalls) {
+        if (stall.ThreadId == threadId) {
+            return &stall;
+        }
+    }
+    return nullptr;
+}
+
+int main() {
+    std::atomic<int> reported(0);
+    CHECK(StartWatchdog(50, OnStall, &reported) == 0);
+    CHECK(StartWatchdog(50, OnStall, &reported) == EBUSY);
+
+    // A wait on an event last set by this thread, which isn't itself blocked
+    neosmart_event_t slow = CreateEvent();
+    SetEventName(slow, "slow");
+    SetEvent(slow);
+    ResetEvent(slow);
+    std::atomic<uint64_t> slowWaiter(0);
+    std::thread waiter([&]() {
+        slowWaiter = detail::CurrentThreadId();
+        WaitForEvent(slow);
+    });
+    CHECK(AwaitStalls(reported, 1));
+    // Long enough for several more scans, none of which should report the same wait again
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    SetEvent(slow);
+    waiter.join();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        CHECK(stalls.size() == 1);
+        const neosmart_stall_t &stall = stalls[0];
+        CHECK(stall.ThreadId == slowWaiter && !stall.MultiWait);
+        CHECK(stall.WaitNanoseconds >= 50 * 1000 * 1000);
+        CHECK(stall.EventCount == 1 && stall.Events[0] == slow);
+        CHECK(std::string(stall.Names[0]) == "slow");
+        CHECK(stall.LastSetters[0] == detail::CurrentThreadId());
+        CHECK(stall.CycleLength == 0);
+        stalls.clear();
+    }
+
+    // Two threads, each blocked on the event the other last set
+    neosmart_event_t first = CreateEvent();
+    neosmart_event_t second = CreateEvent();
+    neosmart_event_t never = CreateEvent(true, false);
+    std::atomic<uint64_t> firstThread(0), secondThread(0);
+    std::atomic<int> ready(0);
+    std::thread a([&]() {
+        firstThread = detail::CurrentThreadId();
+        SetEvent(first);
+        ResetEvent(first);
+        ++ready;
+        while (ready.load() < 2) {
+            std::this_thread::yield();
+        }
+        WaitForEvent(second);
+    });
+    std::thread b([&]() {
+        secondThread = detail::CurrentThreadId();
+        SetEvent(second);
+        ResetEvent(second);
+        ++ready;
+        while (ready.load() < 2) {
+            std::this_thread::yield();
+        }
+#ifdef WFMO
+        neosmart_event_t events[2] = {never, first};
+        int index;
+        WaitForMultipleEvents(events, 2, false, -1ul, index);
+#else
+        WaitForEvent(first);
+#endif
+    });
+    CHECK(AwaitStalls(reported, 3));
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        const neosmart_stall_t *stall = FindStall(firstThread);
+        CHECK(stall != nullptr && stall->LastSetters[0] == secondThread);
+        CHECK(stall->CycleLength == 2);
+        CHECK(stall->Cycle[0] == firstThread && stall->Cycle[1] == secondThread);
+
+        stall = FindStall(secondThread);
+        CHECK(stall != nullptr && stall->CycleLength == 2);
+        CHECK(stall->Cycle[0] == secondThread && stall->Cycle[1] == firstThread);
+#ifdef WFMO
+        CHECK(stall->MultiWait && !stall->WaitAll && stall->EventCount == 2);
+        CHECK(stall->LastSetters[0] + stall->LastSetters[1] == firstThread);
+#endif
+    }
+    SetEvent(first);
+    SetEvent(second);
+    a.join();
+    b.join();
+
+    CHECK(StopWatchdog() == 0);
+    CHECK(StopWatchdog() == ESRCH);
+    DestroyEvent(slow);
+    DestroyEvent(first);
+    DestroyEvent(second);
+    DestroyEvent(never);
+    return 0;
+}
@@ -0,0 +1,103 @@
+// Test that events declared directly as globals or members are constant initialized, allocate
+// nothing of their own, and work with the rest of the API, WFMO included.
+#include <iostream>
+#include <pevents.h>
+#include <thread>
+
+using namespace neosmart;
+
+static size_t allocations = 0;
+
+void *CountingAllocate(size_t size, size_t alignment, void *context) {
+    auto heap = static_cast<const neosmart_allocator_t *>(context);
+    ++allocations;
+    return heap->Allocate(size, alignment, heap->Context);
+}
+
+void CountingDeallocate(void *memory, size_t size, size_t alignment, void *context) {
+    auto heap = static_cast<const neosmart_allocator_t *>(context);
+    heap->Deallocate(memory, size, alignment, heap->Context);
+}
+
+extern neosmart_event_t_ lateEvent;
+
+// Dynamically initialized, and so runs after every constant initializer, including that of
+// lateEvent below. Were lateEvent initialized at runtime, it would run after this and reset it.
+struct EarlySetter {
+    EarlySetter() {
+        SetEvent(&lateEvent);
+    }
+} earlySetter;
+
+neosmart_event_t_ lateEvent(true, false);
+
+struct Worker {
+    neosmart_event_t_ Start;
+    neosmart_event_t_ Stop{true, false};
+};
+
+int main() {
+    if (WaitForEvent(&lateEvent, 0) != 0) {
+        std::cout << "Static event was initialized after use!" << std::endl;
+        return 1;
+    }
+
+    // Static, as the events below may release memory through it on exit
+    static neosmart_allocator_t allocator = {
+        CountingAllocate, CountingDeallocate,
+        const_cast<neosmart_allocator_t *>(GetDefaultAllocator())};
+    SetDefaultAllocator(&allocator);
+
+    {
+        Worker worker;
+        if (WaitForEvent(&worker.Start, 0) != WAIT_TIMEOUT ||
+            WaitForEvent(&worker.Stop, 0) != WAIT_TIMEOUT) {
+            std::cout << "Member events were created signalled!" << std::endl;
+            return 1;
+        }
+        std::thread thread([&]() {
+            WaitForEvent(&worker.Start);
+            SetEvent(&worker.Stop);
+        });
+        SetEvent(&worker.Start);
+        if (WaitForEvent(&worker.Stop, 1000) != 0) {
+            std::cout << "Member events didn't round trip!" << std::endl;
+            return 1;
+        }
+        thread.join();
+        // Auto-reset by default
+        if (WaitForEvent(&worker.Start, 0) != WAIT_TIMEOUT) {
+            std::cout << "Member event didn't auto-reset!" << std::endl;
+            return 1;
+        }
+    }
+
+#ifndef LATENCY
+    // (Measuring wake latencies allocates a histogram for each event that wakes a waiter.) When
+    // tracing, the worker thread takes a ring to record into; this one's came before main().
+    size_t expected = 0;
+#ifdef TRACE
+    expected = 1;
+#endif
+    if (allocations != expected) {
+        std::cout << "Static events allocated memory!" << std::endl;
+        return 1;
+    }
+#endif
+
+#ifdef WFMO
+    static neosmart_event_t_ others[2];
+    neosmart_event_t events[3] = {&others[0], &lateEvent, &others[1]};
+    ResetEvent(&lateEvent);
+    std::thread setter([&]() { SetEvent(&lateEvent); });
+    int index = -1;
+    if (WaitForMultipleEvents(events, 3, false, 1000, index) != 0 || index != 1) {
+        std::cout << "WFMO over static events returned the wrong index!" << std::endl;
+        return 1;
+    }
+    setter.join();
+#endif
+
+    SetDefaultAllocator(NULL);
+    return 0;
+}
@@ -0,0 +1,110 @@
+// Test that the USDT probes documented in the README are all in the binary, under the names they're
+// documented with, by reading the probe notes out of this executable's .note.stapsdt section.
+#include <elf.h>
+#include <fcntl.h>
+#include <iostream>
+#include <pevents.h>
+#include <set>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace neosmart;
+
+#define CHECK(condition)                                                                           \
+    if (!(condition)) {                                                                            \
+        std::cout << "Check failed: " #condition << std::endl;                                    \
+        return 1;                                                                                  \
+    }
+
+#if UINTPTR_MAX > 0xFFFFFFFF
+typedef Elf64_Ehdr Ehdr;
+typedef Elf64_Shdr Shdr;
+typedef Elf64_Nhdr Nhdr;
+#else
+typedef Elf32_Ehdr Ehdr;
+typedef Elf32_Shdr Shdr;
+typedef Elf32_Nhdr Nhdr;
+#endif
+
+// The names of every probe of the pevents provider in the ELF image `image`
+static std::set<std::string> ListProbes(const char *image) {
+    std::set<std::string> probes;
+    const Ehdr *header = reinterpret_cast<const Ehdr *>(image);
+    const Shdr *sections = reinterpret_cast<const Shdr *>(image + header->e_shoff);
+    const char *sectionNames = image + sections[header->e_shstrndx].sh_offset;
+    for (int i = 0; i < header->e_shnum; ++i) {
+        if (strcmp(sectionNames + sections[i].sh_name, ".note.stapsdt") != 0) {
+            continue;
+        }
+        const char *note = image + sections[i].sh_offset;
+        const char *end = note + sections[i].sh_size;
+        while (note + sizeof(Nhdr) <= end) {
+            const Nhdr *noteHeader = reinterpret_cast<const Nhdr *>(note);
+            const char *name = note + sizeof(Nhdr);
+            const char *desc = name + ((noteHeader->n_namesz + 3) & ~3u);
+            note = desc + ((noteHeader->n_descsz + 3) & ~3u);
+            if (noteHeader->n_type != 3 || strcmp(name, "stapsdt") != 0) {
+                continue;
+            }
+            // The probe's address, the .stapsdt.base address and its semaphore come first
+            const char *provider = desc + 3 * sizeof(uintptr_t);
+            const char *probe = provider + strlen(provider) + 1;
+            if (strcmp(provider, "pevents") == 0) {
+                probes.insert(probe);
+            }
+        }
+    }
+    return probes;
+}
+
+int main() {
+    // Exercised so that probes in inline code are emitted in header-only builds as well
+    neosmart_event_t event = CreateEvent(false, false);
+    SetEvent(event);
+    WaitForEvent(event, 0);
+    ResetEvent(event);
+#ifdef WFMO
+    WaitForMultipleEvents(&event, 1, false, 0);
+#endif
+    DestroyEvent(event);
+    neosmart_event_t events[2];
+    CreateEvents(events, 2);
+    DestroyEvents(events, 2);
+
+    std::set<std::string> documented = {"create",   "destroy", "set",         "reset", "wait_begin",
+                                        "wait_end", "wait_expired"};
+#ifdef WFMO
+    documented.insert({"wfmo_begin", "wfmo_end", "wfmo_register"});
+#endif
+
+    int fd = open("/proc/self/exe", O_RDONLY);
+    CHECK(fd >= 0);
+    struct stat status;
+    CHECK(fstat(fd, &status) == 0);
+    void *image = mmap(NULL, status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    CHECK(image != MAP_FAILED);
+    std::set<std::string> probes = ListProbes(static_cast<const char *>(image));
+    munmap(image, status.st_size);
+    close(fd);
+
+    bool matched = true;
+    for (const std::string &probe : documented) {
+        if (probes.count(probe) == 0) {
+            std::cout << "Probe " << probe << " is missing!" << std::endl;
+            matched = false;
+        }
+    }
+    for (const std::string &probe : probes) {
+        if (documented.count(probe) == 0) {
+            std::cout << "Probe " << probe << " isn't documented!" << std::endl;
+            matched = false;
+        }
+    }
+    CHECK(matched);
+
+    return 0;
+}
@@ -0,0 +1,100 @@
+// Test that waits report which thread set the event they returned on, when, and with what tag,
+// whether or not they blocked, and that sets made without SetEventEx() aren't attributed
+#include <atomic>
+#include <iostream>
+#include <pevents.h>
+#include <stdlib.h>
+#include <string>
+#include <sys/mman.h>
+#include <thread>
+#include <unistd.h>
+
+using namespace neosmart;
+
+#define CHECK(condition)                                                                           \
+    if (!(condition)) {                                                                            \
+        std::cout << "Check failed: " #condition << std::endl;                                    \
+        return 1;                                                                                  \
+    }
+
+int main() {
+    neosmart_event_t event = CreateEvent();
+    neosmart_wake_t wake;
+
+    // Woken by another thread
+    std::atomic<uint64_t> setter(0);
+    uint64_t before = detail::Now();
+    std::thread thread([&]() {
+        setter = detail::CurrentThreadId();
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        SetEventEx(event, 1234);
+    });
+    CHECK(WaitForEventEx(event, -1ul, &wake) == 0);
+    thread.join();
+    CHECK(wake.Index == 0 && wake.Tag == 1234);
+    CHECK(wake.SetterThreadId == setter && setter != detail::CurrentThreadId());
+    CHECK(wake.SetNanoseconds >= before && wake.SetNanoseconds <= detail::Now());
+
+    // Already set
+    SetEventEx(event, 7);
+    CHECK(WaitForEventEx(event, 0, &wake) == 0);
+    CHECK(wake.Tag == 7 && wake.SetterThreadId == detail::CurrentThreadId());
+
+    // Set without attribution
+    SetEvent(event);
+    CHECK(WaitForEventEx(event, 0, &wake) == 0);
+    CHECK(wake.Tag == 0 && wake.SetterThreadId == 0 && wake.SetNanoseconds == 0);
+    CHECK(WaitForEventEx(event, 0, &wake) == WAIT_TIMEOUT);
+
+#ifdef WFMO
+    neosmart_event_t events[3];
+    for (int i = 0; i < 3; ++i) {
+        events[i] = CreateEvent();
+    }
+    thread = std::thread([&]() {
+        setter = detail::CurrentThreadId();
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        SetEventEx(events[2], 42);
+    });
+    CHECK(WaitForMultipleEventsEx(events, 3, false, -1ul, &wake) == 0);
+    thread.join();
+    CHECK(wake.Index == 2 && wake.Tag == 42 && wake.SetterThreadId == setter);
+
+    // A wait-all that doesn't block is attributed to its last event
+    for (int i = 0; i < 3; ++i) {
+        SetEventEx(events[i], 100 + i);
+    }
+    CHECK(WaitForMultipleEventsEx(events, 3, true, 0, &wake) == 0);
+    CHECK(wake.Index == 2 && wake.Tag == 102);
+
+    // And one that does, to the set that completed it
+    SetEventEx(events[0], 200);
+    SetEventEx(events[2], 202);
+    thread = std::thread([&]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        SetEventEx(events[1], 201);
+    });
+    CHECK(WaitForMultipleEventsEx(events, 3, true, -1ul, &wake) == 0);
+    thread.join();
+    CHECK(wake.Index == 1 && wake.Tag == 201);
+
+    for (int i = 0; i < 3; ++i) {
+        DestroyEvent(events[i]);
+    }
+#endif
+
+#ifdef NAMED
+    // In a shared WFMO pool of our own, rather than the one used by the whole machine
+    std::string pool = "/pevents.test.wfmo." + std::to_string(getpid());
+    setenv("PEVENTS_WFMO_POOL", pool.c_str(), 1);
+    neosmart_event_t named = CreateEvent("pevents-attribution-test", false, false);
+    SetEventEx(named, 99);
+    CHECK(WaitForEventEx(named, 0, &wake) == 0);
+    CHECK(wake.Tag == 99 && wake.SetterThreadId == detail::CurrentThreadId());
+    DestroyEvent(named);
+    shm_unlink(pool.c_str());
+#endif
+
+    DestroyEvent(event);
+    return 0;
+}
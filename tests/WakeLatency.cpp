@@ -0,0 +1,76 @@
+// Test that wake latencies are sampled for waits that were woken by an event (and only those),
+// and aggregated into the event's histogram, including waits through neosmart::Event
+#include <chrono>
+#include <iostream>
+#include <pevents.h>
+#include <thread>
+
+using namespace neosmart;
+
+#define CHECK(condition)                                                                           \
+    if (!(condition)) {                                                                            \
+        std::cout << "Check failed: " #condition << std::endl;                                    \
+        return 1;                                                                                  \
+    }
+
+int main() {
+    // Bucket boundaries
+    CHECK(LatencyBucketBase(7) == 7);
+    CHECK(LatencyBucketBase(8) == 8);
+    CHECK(LatencyBucketBase(16) == 16);
+    CHECK(LatencyBucketBase(17) == 18);
+
+    neosmart_event_t event = CreateEvent(false, true);
+    CHECK(WaitForEvent(event, 0) == 0);
+    CHECK(GetLastWakeLatency() == 0);
+
+    const int rounds = 20;
+    for (int i = 0; i < rounds; ++i) {
+        std::thread setter([&]() {
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+            SetEvent(event);
+        });
+        CHECK(WaitForEvent(event) == 0);
+        // Every wake-up takes a few microseconds at the very least, and we're far below a second
+        CHECK(GetLastWakeLatency() > 0 && GetLastWakeLatency() < 1000 * 1000 * 1000);
+        setter.join();
+    }
+
+    neosmart_latency_stats_t stats;
+    CHECK(GetEventLatencies(event, &stats) == 0);
+    CHECK(stats.Count == rounds);
+    CHECK(stats.Min <= stats.Max);
+    uint64_t median = LatencyPercentile(&stats, 50);
+    CHECK(median >= stats.Min && median <= stats.Max);
+    CHECK(LatencyPercentile(&stats, 100) == stats.Max);
+
+#ifdef WFMO
+    neosmart_event_t events[2] = {CreateEvent(), event};
+    std::thread setter([&]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        SetEvent(event);
+    });
+    int index = -1;
+    CHECK(WaitForMultipleEvents(events, 2, false, -1, index) == 0 && index == 1);
+    CHECK(GetLastWakeLatency() > 0);
+    setter.join();
+    CHECK(GetEventLatencies(event, &stats) == 0);
+    CHECK(stats.Count == rounds + 1);
+    DestroyEvent(events[0]);
+#endif
+
+#ifndef _WIN32
+    Event owned;
+    std::thread ownedSetter([&]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        owned.Set();
+    });
+    CHECK(owned.Wait() == 0);
+    ownedSetter.join();
+    CHECK(GetEventLatencies(owned.native(), &stats) == 0);
+    CHECK(stats.Count == 1);
+#endif
+
+    DestroyEvent(event);
+    return 0;
+}
@@ -0,0 +1,135 @@
+// Test that a capture records every call made while it runs, with events created beforehand
+// recorded when first used, and that it can only be started and stopped once at a time
+#include <errno.h>
+#include <iostream>
+#include <map>
+#include <pcapture.h>
+#include <pevents.h>
+#include <stdio.h>
+#include <string.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace neosmart;
+
+int main() {
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/pevents-capture-%d.bin", (int)getpid());
+
+    neosmart_event_t existing = CreateEvent(true, true);
+    if (StopCapture() != ESRCH) {
+        std::cout << "Stopped a capture that wasn't running!" << std::endl;
+        return 1;
+    }
+    if (StartCapture(path) != 0) {
+        std::cout << "Couldn't start a capture!" << std::endl;
+        return 1;
+    }
+    if (StartCapture(path) != EBUSY) {
+        std::cout << "Started a second capture!" << std::endl;
+        return 1;
+    }
+
+    neosmart_event_t event = CreateEvent();
+    std::thread waiter([&]() { WaitForEvent(event); });
+    SetEvent(event);
+    waiter.join();
+    ResetEvent(existing);
+#ifdef WFMO
+    neosmart_event_t events[2] = {event, existing};
+    int index;
+    WaitForMultipleEvents(events, 2, false, 0, index);
+#endif
+    DestroyEvent(event);
+
+    if (StopCapture() != 0) {
+        std::cout << "Couldn't stop the capture!" << std::endl;
+        return 1;
+    }
+    // Not captured
+    ResetEvent(existing);
+    DestroyEvent(existing);
+
+    FILE *file = fopen(path, "rb");
+    neosmart_capture_header_t header;
+    if (file == NULL || fread(&header, sizeof(header), 1, file) != 1 ||
+        memcmp(header.Magic, "pevents", 8) != 0 || header.Version != CAPTURE_VERSION ||
+        header.RecordSize != sizeof(neosmart_capture_record_t)) {
+        std::cout << "Capture has no valid header!" << std::endl;
+        return 1;
+    }
+    std::vector<neosmart_capture_record_t> records;
+    std::map<uint32_t, uint8_t> created;
+    neosmart_capture_record_t record;
+    while (fread(&record, sizeof(record), 1, file) == 1) {
+        records.push_back(record);
+        if (record.Op == CAPTURE_CREATE) {
+            created[record.Event] = record.Flags;
+        }
+        std::vector<uint32_t> ids(record.Count);
+        if (record.Count != 0 &&
+            fread(ids.data(), sizeof(uint32_t), ids.size(), file) != ids.size()) {
+            std::cout << "Capture is missing a WFMO record's events!" << std::endl;
+            return 1;
+        }
+        for (uint32_t id : ids) {
+            if (created.find(id) == created.end()) {
+                std::cout << "WFMO record refers to an event never created!" << std::endl;
+                return 1;
+            }
+        }
+    }
+    fclose(file);
+    unlink(path);
+
+    // Two creates (one on first use), a wait, a set, a reset, a WFMO and a destroy
+    int counts[6] = {};
+    for (const neosmart_capture_record_t &record : records) {
+        if (record.Op > CAPTURE_WFMO || created.find(record.Event) == created.end()) {
+            std::cout << "Record has a bad op or an event never created!" << std::endl;
+            return 1;
+        }
+        ++counts[record.Op];
+    }
+#ifdef WFMO
+    const int wfmos = 1;
+#else
+    const int wfmos = 0;
+#endif
+    if (counts[CAPTURE_CREATE] != 2 || counts[CAPTURE_WAIT] != 1 || counts[CAPTURE_SET] != 1 ||
+        counts[CAPTURE_RESET] != 1 || counts[CAPTURE_WFMO] != wfmos ||
+        counts[CAPTURE_DESTROY] != 1) {
+        std::cout << "Capture doesn't have the calls made!" << std::endl;
+        return 1;
+    }
+
+    // The event made beforehand is recorded with the state it had when first used
+    bool foundExisting = false;
+    for (const auto &event : created) {
+        if (event.second == (CAPTURE_MANUAL_RESET | CAPTURE_INITIAL_STATE)) {
+            foundExisting = true;
+        }
+    }
+    if (!foundExisting) {
+        std::cout << "Existing manual-reset event wasn't recorded as set!" << std::endl;
+        return 1;
+    }
+
+    // The wait and the set come from different threads
+    uint32_t waitThread = 0;
+    uint32_t setThread = 0;
+    for (const neosmart_capture_record_t &record : records) {
+        if (record.Op == CAPTURE_WAIT) {
+            waitThread = record.Thread;
+        } else if (record.Op == CAPTURE_SET) {
+            setThread = record.Thread;
+        }
+    }
+    if (waitThread == 0 || setThread == 0 || waitThread == setThread) {
+        std::cout << "Calls weren't recorded against their threads!" << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,236 @@
+/*
+ * WIN32 Events for POSIX
+ * Author: Mahmoud Al-Qudsi <mqudsi@neosmart.net>
+ * Copyright (C) 2011 - 2019 by NeoSmart Technologies
+ * This code is released under the terms of the MIT License
+ */
+
+// Replays a capture made with CAPTURE against the pevents this is built with, one thread per
+// captured thread, each making its calls at the same offsets from the start as they were
+// captured at (or as soon as it can, if running behind). Reports, as JSON, how long each kind
+// of call took when captured and when replayed, and how many returned something different.
+//
+// Every event is created up front, with the reset type and initial state it was captured with,
+// and destroyed once the replay is over; captured destroys are skipped. Named events are replayed
+// as local ones. As the replay may not interleave calls exactly as captured, waits can block where
+// the captured ones didn't: once every thread is past its last captured call (plus a second),
+// all events are repeatedly set until the remaining waits return, and those sets are counted.
+//
+// Usage: replay <capture>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <pcapture.h>
+#include <pevents.h>
+#include <stdio.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+using namespace neosmart;
+
+namespace {
+    // A captured call to replay
+    struct Call {
+        neosmart_capture_record_t Record;
+        std::vector<uint32_t> Events;
+        // How long the call took and what it returned when replayed
+        uint64_t Duration;
+        int Result;
+    };
+
+    uint64_t Now() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    }
+
+    double Percentile(std::vector<double> &samples, double fraction) {
+        if (samples.empty()) {
+            return 0;
+        }
+        std::sort(samples.begin(), samples.end());
+        return samples[std::min((size_t)(fraction * samples.size()), samples.size() - 1)];
+    }
+
+    void Replay(std::vector<Call> &calls, std::map<uint32_t, neosmart_event_t> &events,
+                uint64_t start) {
+#ifdef WFMO
+        std::vector<neosmart_event_t> waited;
+#endif
+        for (Call &call : calls) {
+            const neosmart_capture_record_t &record = call.Record;
+            std::this_thread::sleep_until(
+                std::chrono::steady_clock::time_point(std::chrono::duration_cast<
+                                                      std::chrono::steady_clock::duration>(
+                    std::chrono::nanoseconds(start + record.Begin))));
+
+            neosmart_event_t event = events.at(record.Event);
+            uint64_t begin = Now();
+            switch (record.Op) {
+            case CAPTURE_SET:
+                call.Result = SetEvent(event);
+                break;
+            case CAPTURE_RESET:
+                call.Result = ResetEvent(event);
+                break;
+            case CAPTURE_WAIT:
+                call.Result = WaitForEvent(event, record.Timeout);
+                break;
+#ifdef WFMO
+            case CAPTURE_WFMO:
+                waited.clear();
+                for (uint32_t id : call.Events) {
+                    waited.push_back(events.at(id));
+                }
+                call.Result =
+                    WaitForMultipleEvents(waited.data(), (int)waited.size(),
+                                          record.Flags & CAPTURE_WAIT_ALL, record.Timeout);
+                break;
+#endif
+            }
+            call.Duration = Now() - begin;
+        }
+    }
+
+    const char *OpName(int op) {
+        static const char *const names[] = {"create",       "destroy",
+                                            "SetEvent",     "ResetEvent",
+                                            "WaitForEvent", "WaitForMultipleEvents"};
+        return names[op];
+    }
+} // namespace
+
+int main(int argc, const char *argv[]) {
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s <capture>\n", argv[0]);
+        return 2;
+    }
+    FILE *file = fopen(argv[1], "rb");
+    if (file == NULL) {
+        perror(argv[1]);
+        return 1;
+    }
+    neosmart_capture_header_t header;
+    if (fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.Magic, "pevents", 8) != 0 ||
+        header.Version != CAPTURE_VERSION ||
+        header.RecordSize != sizeof(neosmart_capture_record_t)) {
+        fprintf(stderr, "%s isn't a pevents capture this replay understands\n", argv[1]);
+        return 1;
+    }
+
+    std::map<uint32_t, uint8_t> created;
+    std::map<uint32_t, std::vector<Call>> threads;
+    uint64_t capturedEnd = 0;
+    size_t skipped = 0;
+    Call call = {};
+    while (fread(&call.Record, sizeof(call.Record), 1, file) == 1) {
+        const neosmart_capture_record_t &record = call.Record;
+        call.Events.resize(record.Count);
+        if (record.Count != 0 &&
+            fread(call.Events.data(), sizeof(uint32_t), record.Count, file) != record.Count) {
+            fprintf(stderr, "%s is truncated\n", argv[1]);
+            return 1;
+        }
+        if (record.Op == CAPTURE_CREATE) {
+            created[record.Event] = record.Flags;
+            continue;
+        }
+        // Should the creation have been lost, the event is replayed as an auto-reset one
+        created.insert({record.Event, 0});
+        for (uint32_t id : call.Events) {
+            created.insert({id, 0});
+        }
+#ifndef WFMO
+        if (record.Op == CAPTURE_WFMO) {
+            ++skipped;
+            continue;
+        }
+#endif
+        if (record.Op == CAPTURE_DESTROY) {
+            continue;
+        }
+        capturedEnd = std::max(capturedEnd, record.Begin + record.Duration);
+        threads[record.Thread].push_back(call);
+    }
+    fclose(file);
+
+    // Only read once the replay starts
+    std::map<uint32_t, neosmart_event_t> events;
+    for (const auto &event : created) {
+        events[event.first] = CreateEvent(event.second & CAPTURE_MANUAL_RESET,
+                                          event.second & CAPTURE_INITIAL_STATE);
+    }
+
+    // Starts once every thread is up, so that none begins behind
+    uint64_t start = Now() + 10 * 1000 * 1000;
+    std::atomic<size_t> running(threads.size());
+    std::vector<std::thread> replayers;
+    for (auto &thread : threads) {
+        std::vector<Call> *calls = &thread.second;
+        replayers.emplace_back([&, calls]() {
+            Replay(*calls, events, start);
+            --running;
+        });
+    }
+
+    // Waits left blocked after the last call should have been made are released
+    uint64_t deadline = start + capturedEnd + 1000 * 1000 * 1000;
+    size_t forcedSets = 0;
+    while (running != 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        if (Now() > deadline) {
+            for (const auto &event : events) {
+                SetEvent(event.second);
+                ++forcedSets;
+            }
+        }
+    }
+    uint64_t replayedEnd = Now() - start;
+    for (std::thread &replayer : replayers) {
+        replayer.join();
+    }
+    for (const auto &event : events) {
+        DestroyEvent(event.second);
+    }
+
+    printf("{\n  \"capture\": \"%s\",\n  \"threads\": %zu,\n  \"events\": %zu,\n", argv[1],
+           threads.size(), events.size());
+    printf("  \"captured_ns\": %llu,\n  \"replayed_ns\": %llu,\n",
+           (unsigned long long)capturedEnd, (unsigned long long)replayedEnd);
+    printf("  \"skipped_calls\": %zu,\n  \"forced_sets\": %zu,\n  \"calls\": [", skipped,
+           forcedSets);
+    bool first = true;
+    for (int op = CAPTURE_SET; op <= CAPTURE_WFMO; ++op) {
+        std::vector<double> captured;
+        std::vector<double> replayed;
+        size_t mismatches = 0;
+        for (const auto &thread : threads) {
+            for (const Call &call : thread.second) {
+                if (call.Record.Op == op) {
+                    captured.push_back(call.Record.Duration);
+                    replayed.push_back(call.Duration);
+                    mismatches += call.Result != call.Record.Result;
+                }
+            }
+        }
+        if (captured.empty()) {
+            continue;
+        }
+        printf("%s\n    {\"name\": \"%s\", \"count\": %zu, \"result_mismatches\": %zu, ",
+               first ? "" : ",", OpName(op), captured.size(), mismatches);
+        double p50 = Percentile(captured, 0.5);
+        double p99 = Percentile(captured, 0.99);
+        double replayedP50 = Percentile(replayed, 0.5);
+        double replayedP99 = Percentile(replayed, 0.99);
+        printf("\"captured\": {\"p50_ns\": %.0f, \"p99_ns\": %.0f}, ", p50, p99);
+        printf("\"replayed\": {\"p50_ns\": %.0f, \"p99_ns\": %.0f}, ", replayedP50, replayedP99);
+        printf("\"difference\": {\"p50_ns\": %.0f, \"p99_ns\": %.0f}}", replayedP50 - p50,
+               replayedP99 - p99);
+        first = false;
+    }
+    printf("\n  ]\n}\n");
+    return 0;
+}